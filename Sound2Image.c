@@ -8,10 +8,12 @@
 #include <allegro5/allegro_ttf.h>
 #include <pthread.h>
 #include <math.h>
+#include <float.h>
 
 #include "constants.h"
 #include "time_utils.h"
 #include "fft_audio.h"
+#include "fft_kernels.h"
 #include "btrails.h"
 #include "ptask.h"
 
@@ -31,6 +33,10 @@ do { \
 	pthread_mutex_unlock(&lock); \
 } while (0)
 
+// Minimum and maximum of two values
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+
 // Shorthand for protect a small critical section
 #define MUTEX_EXP(lock, expr) \
 do { \
@@ -56,19 +62,21 @@ void allegro_check(bool test,
 
 // Allegro help functions
 void allegro_init();
+ALLEGRO_CHANNEL_CONF allegro_channel_conf(size_t n);
 void allegro_stream_set_gain(size_t val);
-int allegro_stream_fill_frame();
+float * allegro_stream_get_fragment();
+void allegro_stream_set_fragment(float * buffer);
 void allegro_blender_mode_standard();
 void allegro_blender_mode_alpha();
 void allegro_free();
 
 // Bubble help functions
 float bubble_spacing_with(size_t n);
-fft_audio_range bubble_samples_range(const size_t id,
-									 const size_t n);
-float bubble_calculate_val(const size_t id,
-						   const float val_old,
-						   const fft_audio_range range);
+void bubble_init_range_table();
+void bubble_free_range_table();
+void bubble_update_ranges(const size_t n);
+void bubble_compute_stats(const size_t n);
+void bubble_compute_vals(const size_t n);
 
 // Draw help functions
 void draw_trail(const size_t id,
@@ -103,8 +111,10 @@ ALLEGRO_FONT * font_small;			// font used to draw text with small size
 
 // Shared data structures
 size_t samplerate;					// samplerate of the audio file
+size_t analysis_samplerate;			// samplerate of the FFT values
 size_t channels;					// number of channels of the audio file
 size_t frame_samples;				// number of samples provided to the stream
+size_t fft_samples;					// length of the FFT
 int done;							// if TRUE the program stops
 size_t active_tasks;				// num. of tasks active
 size_t gain;						// volume gain of the audio
@@ -130,6 +140,20 @@ pthread_cond_t cond_fft_consumers;	// cond. var. associated to all task_bubble
 pthread_mutex_t mux_fft;			// mutex associated to the prev. cond. var.
 size_t counter_fft;					// variable to make synchronization
 
+// Bands and ranges of each bubble for every number of bubbles, computed at
+// startup and only read afterwards, so that no lock is needed to access them
+fft_audio_filterbank * bubble_filterbanks[BUBBLE_TASKS_MAX + 1];
+fft_audio_range bubble_range_table[BUBBLE_TASKS_MAX + 1][BUBBLE_TASKS_MAX];
+
+// Data computed by task_fft for all task_bubble, protected by mux_fft
+fft_audio_stats audio_stats;						// min. and max. of all
+													// bubbles, avg. unused
+const fft_audio_range * bubble_ranges;				// range of each bubble
+size_t bubble_ranges_n = 0;							// active bubbles
+fft_audio_stats bubble_stats[BUBBLE_TASKS_MAX];		// stats of each bubble
+float bubble_avgs[BUBBLE_TASKS_MAX];				// band val. of each bubble
+float bubble_vals[BUBBLE_TASKS_MAX];				// value of each bubble
+
 
 //------------------------------------------------------------------------------
 // SOUND2IMAGE FUNCTION DEFINITIONS
@@ -270,6 +294,37 @@ void allegro_init()
 }
 
 
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the Allegro channel configuration of an audio stream
+// with "n" channels. If Allegro does not support "n" channels, it prints an
+// error message and exits the program.
+//
+// PARAMETERS
+// n: the number of channels of the audio stream
+//
+// RETURN
+// The Allegro channel configuration with "n" channels.
+//
+//------------------------------------------------------------------------------
+ALLEGRO_CHANNEL_CONF allegro_channel_conf(size_t n)
+{
+	switch (n) {
+		case 1: return ALLEGRO_CHANNEL_CONF_1;
+		case 2: return ALLEGRO_CHANNEL_CONF_2;
+		case 3: return ALLEGRO_CHANNEL_CONF_3;
+		case 4: return ALLEGRO_CHANNEL_CONF_4;
+		case 6: return ALLEGRO_CHANNEL_CONF_5_1;
+		case 7: return ALLEGRO_CHANNEL_CONF_6_1;
+		case 8: return ALLEGRO_CHANNEL_CONF_7_1;
+	}
+
+	allegro_check(FALSE, "Unsupported number of channels");
+	return ALLEGRO_CHANNEL_CONF_1;
+}
+
+
 //------------------------------------------------------------------------------
 //
 // DESCRIPTION
@@ -289,26 +344,34 @@ void allegro_stream_set_gain(size_t val)
 //------------------------------------------------------------------------------
 //
 // DESCRIPTION
-// This function tries to copy the current frame audio values into a buffer
-// provided by the streaming object.
+// This function tries to get a free buffer of the streaming object, where the
+// next frame audio values can be decoded.
 //
 // RETURN
-// It returns TRUE if the frame have been copied into the buffer.
-// Otherwise it returns FALSE.
+// It returns the buffer if the streaming object has a free one.
+// Otherwise it returns NULL.
 //
 //------------------------------------------------------------------------------
-int allegro_stream_fill_frame()
+float * allegro_stream_get_fragment()
 {
-	float * buffer = NULL;
-
-	buffer = al_get_audio_stream_fragment(stream);
-	if (buffer != NULL) {
-		fft_audio_fill_buffer_data(buffer);
-		allegro_check(al_set_audio_stream_fragment(stream, buffer),
-					  "al_set_audio_stream_fragment()");
-		return TRUE;
-	}
-	return FALSE;
+	return al_get_audio_stream_fragment(stream);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function gives back to the streaming object a buffer filled with the
+// frame audio values, to be played.
+//
+// PARAMETERS
+// buffer: the buffer returned by allegro_stream_get_fragment()
+//
+//------------------------------------------------------------------------------
+void allegro_stream_set_fragment(float * buffer)
+{
+	allegro_check(al_set_audio_stream_fragment(stream, buffer),
+				  "al_set_audio_stream_fragment()");
 }
 
 
@@ -390,6 +453,7 @@ void allegro_free()
 void sound2image_init_variables(char * filename)
 {
 	ALLEGRO_CHANNEL_CONF ch_conf;	// Number of channels in Allegro 5
+	fft_audio_config fft_config;	// Configuration of fft_audio
 
 	// Variables
 	done = FALSE;
@@ -412,17 +476,32 @@ void sound2image_init_variables(char * filename)
 	pthread_mutex_init(&mux_windowing, NULL);
 
 	// fft_audio
-	fft_audio_check(fft_audio_init(filename, TASK_FFT_PERIOD),
+	fft_config = fft_audio_config_default();
+	fft_config.planner = FFT_PLANNER;
+	fft_config.wisdom_filename = FFT_WISDOM_FILENAME;
+	fft_config.window_samples = FFT_WINDOW_SAMPLES;
+	fft_config.sizing = FFT_SIZING;
+	fft_config.analysis = FFT_ANALYSIS;
+	fft_config.lowres_factor = FFT_LOWRES_FACTOR;
+	fft_config.analysis_bandwidth = FFT_ANALYSIS_BANDWIDTH;
+	fft_config.backend = FFT_BACKEND;
+	fft_config.threads = FFT_THREADS;
+	fft_config.lookahead_frames = FFT_LOOKAHEAD_FRAMES;
+	fft_config.preload = FFT_PRELOAD;
+	fft_audio_check(fft_audio_init_with(filename, TASK_FFT_PERIOD, &fft_config),
 					"File does not exits or it is not compatible");
 	samplerate = fft_audio_get_samplerate();
+	analysis_samplerate = fft_audio_get_analysis_samplerate();
 	channels = fft_audio_get_channels();
 	frame_samples = fft_audio_get_frame_samples();
+	fft_samples = fft_audio_get_fft_samples();
+	bubble_init_range_table();
 
 	// Allegro
 	allegro_init();
 	al_set_target_bitmap(NULL);
 
-	ch_conf = (channels == 2 ? ALLEGRO_CHANNEL_CONF_2 : ALLEGRO_CHANNEL_CONF_1);
+	ch_conf = allegro_channel_conf(channels);
 	stream = al_create_audio_stream(STREAM_FRAME_COUNT,
 									frame_samples,
 									samplerate,
@@ -510,6 +589,7 @@ void sound2image_free()
 	pthread_mutex_destroy(&mux_windowing);
 
 	btrails_free();
+	bubble_free_range_table();
 	fft_audio_free();
 	al_drain_audio_stream(stream);
 	allegro_free();
@@ -539,81 +619,153 @@ float bubble_spacing_with(size_t n)
 //------------------------------------------------------------------------------
 //
 // DESCRIPTION
-// This function calculates the range [from, to] of samples for a given bubble.
-// Values "from" and "to" are calculated as follows:
-// N    = number of samples
-// step = log_2(N / 2 - (n + 1)) / (n + 1)
-// from = round( 2^( step * (id + 1) ) ) + (id + 1)
-// to   = round( 2^( step * (id + 2) ) ) + (id + 2)
+// This function creates the bands of the bubbles for every number of active
+// bubbles, from 1 to BUBBLE_TASKS_MAX, equally spaced on BUBBLE_BANDS_SCALE,
+// and stores the range of samples covered by each band, so that nothing has
+// to be calculated while the audio is played. No band is created for 0
+// bubbles, and the range of inactive bubbles is [0, 0]. It must be called
+// once fft_audio is initialized, before starting the tasks.
 //
-// PARAMETERS
-// id: the bubble id whose range you want to calculate
-// n: the total number of active bubbles
+//------------------------------------------------------------------------------
+void bubble_init_range_table()
+{
+	size_t n;						// number of active bubbles
+	size_t i;						// index of the bubble
+	float max_freq;					// upper edge of the highest band
+	const fft_audio_range * ranges;	// ranges of the bands of "n" bubbles
+
+	max_freq = MIN(BUBBLE_BANDS_MAX_FREQ, analysis_samplerate / 2.0f);
+
+	bubble_filterbanks[0] = NULL;
+	for (n = 1; n <= BUBBLE_TASKS_MAX; ++n) {
+		fft_audio_check(fft_audio_filterbank_init(&bubble_filterbanks[n],
+												  BUBBLE_BANDS_SCALE, n,
+												  BUBBLE_BANDS_MIN_FREQ,
+												  max_freq),
+						"Cannot create the bands of the bubbles");
+	}
+
+	for (n = 0; n <= BUBBLE_TASKS_MAX; ++n) {
+		for (i = 0; i < BUBBLE_TASKS_MAX; ++i) {
+			bubble_range_table[n][i].from = 0;
+			bubble_range_table[n][i].to = 0;
+		}
+		if (n > 0) {
+			ranges = fft_audio_filterbank_get_ranges(bubble_filterbanks[n]);
+			for (i = 0; i < n; ++i) {
+				bubble_range_table[n][i] = ranges[i];
+			}
+		}
+	}
+
+	bubble_ranges = bubble_range_table[0];
+}
+
+
+//------------------------------------------------------------------------------
 //
-// RETURN
-// The range [from, to] of samples for a given bubble.
-// If the bubble id is greater or equal to "n", the range returned is [0, 0].
+// DESCRIPTION
+// This function frees the bands of the bubbles created by
+// bubble_init_range_table().
 //
 //------------------------------------------------------------------------------
-fft_audio_range bubble_samples_range(const size_t id,
-									 const size_t n)
+void bubble_free_range_table()
 {
-	float step;					// the step exponent to calculate from and to
-	fft_audio_range range;		// the range [from, to] to be calculated
-
-	if (id < n) {
-		step = log2f(frame_samples / channels - (n + 1)) / (n + 1);
-		range.from = (size_t)lroundf(powf(2, (id + 1) * step)) + id + 1;
-		range.to = (size_t)lround(powf(2, (id + 2) * step)) + id + 2;
-	} else {
-		range.from = 0;
-		range.to = 0;
-	}
+	size_t n;		// number of active bubbles
 
-	return range;
+	for (n = 0; n <= BUBBLE_TASKS_MAX; ++n) {
+		fft_audio_filterbank_free(bubble_filterbanks[n]);
+		bubble_filterbanks[n] = NULL;
+	}
 }
 
 
 //------------------------------------------------------------------------------
 //
 // DESCRIPTION
-// This function is an auxiliary function used to calculate a new value needed
-// to calculate the y coordinate of a new bubble.
-// This values is calculated based on the statistics of the current played frame
-// and it is filtered by a low-pass filter.
+// This function selects the ranges of samples of the bubbles when the number
+// of active bubbles changes, and declares the new ranges to fft_audio so that
+// it can choose the cheapest way to compute them. Both only read tables built
+// at startup, with no transcendental math. It must be called holding mux_fft,
+// before computing the FFT.
 //
 // PARAMETERS
-// id: the bubble id whose value you want to calculate
-// val_old: the old value. It is needed to apply the low-pass filter
-// range: the range [from, to] of samples assigned to the bubble
+// n: the number of active bubbles, not greater than BUBBLE_TASKS_MAX
 //
-// RETURN
-// It returns 0 if the new value is not finite. Otherwise the new value.
+//------------------------------------------------------------------------------
+void bubble_update_ranges(const size_t n)
+{
+	if (n == bubble_ranges_n) {
+		return;
+	}
+
+	bubble_ranges = bubble_range_table[n];
+	bubble_ranges_n = n;
+
+	fft_audio_set_bands(bubble_ranges, n);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function calculates the value of the band of each of the "n" active
+// bubbles in the current frame, and the statistics of their ranges, with a
+// single call to fft_audio for each, then the minimum and maximum magnitudes
+// of all the bubbles together, used as scale of their values. The values are
+// included, since the bass bands are weighted over the finer bass bins, which
+// may lie slightly outside their ranges.
+// The scale is not taken from the whole spectrum: while fft_audio computes
+// the bubble bands only (the Goertzel engine), the statistics of the whole
+// spectrum are those of the bubble bands, so the scale would jump whenever
+// fft_audio switches engine. The bubble bands are computed alike by every
+// engine. It must be called holding mux_fft.
+//
+// PARAMETERS
+// n: the number of active bubbles
 //
 //------------------------------------------------------------------------------
-float bubble_calculate_val(const size_t id,
-						   const float val_old,
-						   const fft_audio_range range)
+void bubble_compute_stats(const size_t n)
 {
-	float val;						// the new value
-	float valMin;					// the min value of audio frame statistics
-	float valMax;					// the max value of audio frame statistics
-	fft_audio_stats audio_stats;	// statistics of the audio frame
-	fft_audio_stats frame_stats;	// statistics of the audio in the range
-
-	audio_stats = fft_audio_get_stats();
-	frame_stats = fft_audio_get_stats_samples(range);
-
-	valMin = log2f(audio_stats.magMin);
-	valMax = log2f(audio_stats.magMax);
-	val = log2f(frame_stats.magAvg);
-	val = (val - valMin) / (valMax - valMin);
-
-	if (isfinite(val)) {
-		return val_old * BUBBLE_LPASS_PARAM + (1.0f - BUBBLE_LPASS_PARAM) * val;
+	size_t i;		// index of the bubble
+
+	if (n > 0) {
+		fft_audio_get_filterbank_values(bubble_filterbanks[n], bubble_avgs);
+	}
+	fft_audio_get_band_stats(bubble_ranges, n, bubble_stats);
+
+	audio_stats.magMin = FLT_MAX;
+	audio_stats.magMax = 0.0f;
+	for (i = 0; i < n; ++i) {
+		audio_stats.magMin = MIN(audio_stats.magMin, bubble_stats[i].magMin);
+		audio_stats.magMin = MIN(audio_stats.magMin, bubble_avgs[i]);
+		audio_stats.magMax = MAX(audio_stats.magMax, bubble_stats[i].magMax);
+		audio_stats.magMax = MAX(audio_stats.magMax, bubble_avgs[i]);
 	}
+}
 
-	return 0.0f;
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function calculates the value of each of the "n" active bubbles, needed
+// to calculate the y coordinate of their new bubble, with a single vectorized
+// pass over all of them.
+// Each value is the log2 of the value of the bubble band,
+// normalized between the log2 of the min and max magnitudes of all the bubbles
+// in the current played frame, and it is filtered by a low-pass filter. A value
+// which is not finite is reset to 0. It must be called holding mux_fft, after
+// bubble_compute_stats().
+//
+// PARAMETERS
+// n: the number of active bubbles
+//
+//------------------------------------------------------------------------------
+void bubble_compute_vals(const size_t n)
+{
+	fft_kernels_log_normalize(bubble_vals, bubble_avgs, n,
+							  audio_stats.magMin, audio_stats.magMax,
+							  BUBBLE_LPASS_PARAM);
 }
 
 
@@ -827,6 +979,8 @@ void * task_fft(void * arg)
 	const size_t id = ptask_id(arg);		// id of this periodic task
 	int done_local = FALSE;					// local value of done
 	int windowing_local;					// local value of windowing method
+	size_t active_tasks_local;				// local value of active tasks
+	float * buffer;							// stream buffer of the frame
 	int ret;								// ret value
 
 	// Activate for the first time this periodic task
@@ -840,19 +994,34 @@ void * task_fft(void * arg)
 			pthread_cond_wait(&cond_fft_producer, &mux_fft);
 		}
 
-		// Provide new values to the audio stream
-		ret = allegro_stream_fill_frame();
-		if (ret == TRUE) {
+		// Decode the new values straight into a free buffer of the audio
+		// stream, where the FFT reads them too
+		buffer = allegro_stream_get_fragment();
+		if (buffer != NULL) {
+			ret = fft_audio_load_next_frame_into(buffer);
+			if (ret == FFT_AUDIO_UNDERRUN) {
+				fprintf(stderr, "%zu) audio underrun!\n", id);
+			}
+
 			// Update the elapsed audio time
 			MUTEX_EXP(mux_elapsed_time,
 					  elapsed_time += frame_samples * 1000.0 / samplerate);
 
+			// Update the ranges of the bubbles if their number changed
+			MUTEX_EXP(mux_active_tasks, active_tasks_local = active_tasks);
+			bubble_update_ranges(active_tasks_local);
+
 			// Load the current windowing method and compute the FFT
 			MUTEX_EXP(mux_windowing, windowing_local = windowing);
 			fft_audio_compute_fft(windowing_local);
 
-			// Load a new frame for the next period
-			ret = fft_audio_load_next_frame();
+			// Compute the statistics and the values of all active bubbles at
+			// once
+			bubble_compute_stats(active_tasks_local);
+			bubble_compute_vals(active_tasks_local);
+
+			// Play the frame, which is silence past the end of the file
+			allegro_stream_set_fragment(buffer);
 			if (ret == FFT_AUDIO_EOF) {
 				MUTEX_EXP(mux_done, done = TRUE);
 			}
@@ -905,22 +1074,23 @@ void * task_bubble(void * arg)
 
 	while (!done_local) {
 
-		// Update the local value of active_tasks and calculate the spacing
-		MUTEX_EXP(mux_active_tasks, active_tasks_local = active_tasks);
-		bubble_spacing = bubble_spacing_with(active_tasks_local);
-
 		// Wait the computation of task_fft
 		MUTEX_LOCK(mux_fft);
 		while (counter_fft == 0) {
 			pthread_cond_wait(&cond_fft_consumers, &mux_fft);
 		}
 
+		// The active bubbles are those task_fft computed the ranges and values
+		// for, which may differ from active_tasks if it has just changed
+		active_tasks_local = bubble_ranges_n;
+		bubble_spacing = bubble_spacing_with(active_tasks_local);
+
 		// if the task is active calculate the bubble values
 		if (user_id < active_tasks_local) {
-			// calculate the range of samples assigned to the bubble
-			range = bubble_samples_range(user_id, active_tasks_local);
-			// calculate the new value to compute the y position of the bubble
-			val = bubble_calculate_val(user_id, val, range);
+			// load the range of samples assigned to the bubble by task_fft
+			range = bubble_ranges[user_id];
+			// load the value computed by task_fft for the y position
+			val = bubble_vals[user_id];
 			// calculate the color_id
 			color_id = MAX_COLORS * (user_id / (float)active_tasks_local);
 			// calculate the x position of the bubble using the current spacing
@@ -950,7 +1120,7 @@ void * task_bubble(void * arg)
 						  COLORS[color_id][0],
 						  COLORS[color_id][1],
 						  COLORS[color_id][2]);
-		btrails_set_freq(user_id, range.to * samplerate / frame_samples);
+		btrails_set_freq(user_id, range.to * analysis_samplerate / fft_samples);
 		btrails_put_bubble_pos(user_id, x, y);
 		btrails_unlock(user_id);
 
@@ -99,6 +99,53 @@
 #define STREAM_DATA_TYPE		ALLEGRO_AUDIO_DEPTH_FLOAT32
 
 
+//------------------------------------------------------------------------------
+// FFT SETTINGS
+//------------------------------------------------------------------------------
+// effort spent by FFTW to plan the FFT, paid only at the first start
+#define FFT_PLANNER				fft_audio_measure
+// file where the FFTW plans are stored across the starts
+#define FFT_WISDOM_FILENAME		"sound2image.wisdom"
+// samples analysed by the FFT, 0 to analyse exactly one period of audio.
+// Longer windows (e.g. 2048) give finer frequency bins to the bass bubbles
+#define FFT_WINDOW_SAMPLES		0
+// FFT length: the window is lengthened to the next 2^a * 3^b * 5^c samples
+#define FFT_SIZING				fft_audio_sizing_round
+// spectra computed: fft_audio_analysis_channels also analyses each channel
+#define FFT_ANALYSIS			fft_audio_analysis_mono
+// decimation of the long bass FFT, which gives the lowest bubbles 8 times
+// finer bins; 0 to analyse the whole spectrum at a single resolution
+#define FFT_LOWRES_FACTOR		8
+// highest frequency analysed in Hz: hi-res audio (e.g. 96 kHz) is decimated to
+// the lowest samplerate covering it; 0 to analyse the whole band
+#define FFT_ANALYSIS_BANDWIDTH	16000
+// library computing the FFT: fft_audio_backend_builtin needs no FFTW and
+// lengthens the window to the next power of two instead
+#define FFT_BACKEND				fft_audio_backend_fftw
+// FFTW threads of FFTs of 65536 samples and more; the FFT of each period is
+// far shorter, so it always runs on task_fft alone
+#define FFT_THREADS				1
+// periods of audio decoded ahead by a non real-time reader thread, so that
+// task_fft never waits for the disk or the decoder
+#define FFT_LOOKAHEAD_FRAMES	16
+// 1 decodes the whole track into locked memory at startup, replacing the reader
+// thread, for installations looping short tracks
+#define FFT_PRELOAD				0
+
+
+//------------------------------------------------------------------------------
+// BUBBLE BANDS SETTINGS
+//------------------------------------------------------------------------------
+// scale on which the bands of the bubbles are equally spaced: constant-Q gives
+// each octave the same number of bubbles, fft_filterbank_mel favors the mids
+#define BUBBLE_BANDS_SCALE		fft_filterbank_constant_q
+// lowest frequency of the bands in Hz
+#define BUBBLE_BANDS_MIN_FREQ	40.0f
+// highest frequency of the bands in Hz, lowered to half the samplerate
+// analysed if needed
+#define BUBBLE_BANDS_MAX_FREQ	16000.0f
+
+
 //------------------------------------------------------------------------------
 // BUBBLE DISPLAY SETTINGS
 //------------------------------------------------------------------------------
@@ -1,49 +1,169 @@
 #include "fft_audio.h"
+#include "fft_kernels.h"
+#include "fft_decimator.h"
+#include "fft_filterbank.h"
+#include "fft_backend.h"
+#include "fft_reader.h"
+#include "fft_wav.h"
 #include <sndfile.h>
 #include <string.h>
+#include <stdint.h>
 #include <math.h>
-#include <fftw3.h>
 #include <float.h>
 #include <assert.h>
+#include <pthread.h>
+#include <sys/mman.h>
 
 
 //------------------------------------------------------------------------------
 // FFT_AUDIO LOCAL CONSTANTS
 //------------------------------------------------------------------------------
-#define MAX_SAMPLERATE			96000
-#define MAX_CHANNELS			2
-#define MAX_FRAME_SAMPLES		MAX_SAMPLERATE
-#define MAX_DATA_SAMPLES		(MAX_CHANNELS * MAX_SAMPLERATE)
+#define MIN_FRAME_SAMPLES		2
 
 #define SILENCE_VALUE			0.0f
 #define NORM_VALUE				((float)0x8000)
 
+#define ALIGN_SAMPLES			4		// Num. of float values in 16 bytes,
+										// the SIMD alignment of the FFT
+
+// Estimated costs used to choose the engine: the FFT needs about
+// 2.5 * N * log2(N) flops at SIMD throughput, while each Goertzel step of a
+// bin is bound by the latency of its recurrence
+#define FFT_STEP_COST			0.3		// cost per sample and FFT stage
+#define GOERTZEL_STEP_COST		1.0		// cost per sample and bin
+
+// Onset detection: the band amplitudes are compressed as
+// log(1 + ONSET_COMPRESSION * amplitude), so that the noise of quiet bands
+// stays in the linear part of the curve. The threshold of the flux is its
+// moving mean plus ONSET_SENSITIVITY times its moving mean deviation, both
+// updated with weight ONSET_ALPHA (about 20 frames of memory), plus
+// ONSET_MIN_FLUX. After an onset, no other one is detected for ONSET_HOLD_MS
+// milliseconds.
+#define ONSET_COMPRESSION		1000.0f
+#define ONSET_ALPHA				0.05f
+#define ONSET_SENSITIVITY		3.0f
+#define ONSET_MIN_FLUX			0.1f
+#define ONSET_HOLD_MS			100
+
+#define THREADS_MIN_SAMPLES		65536	// Shortest FFT worth splitting among
+										// threads by default
+
+#define PRELOAD_FRAMES			1048576	// Frames first allocated to preload
+										// a file of unknown length
+
 
 //------------------------------------------------------------------------------
 // FFT_AUDIO LOCAL MACROS
 //------------------------------------------------------------------------------
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#define ROUND_UP(n, m) (((n) + (m) - 1) / (m) * (m))
 
 
 //------------------------------------------------------------------------------
 // FFT_AUDIO LOCAL STRUCT DEFINITIONS
 //------------------------------------------------------------------------------
-typedef struct {
-	fftwf_plan plan;							// FFTW float FFT plan
+struct fft_audio_ctx {
+	fft_backend_plan * plan;					// FFT plan
+	fft_wav * wav;								// Mapping of a PCM WAV file,
+												// NULL if "file" is used
 	SNDFILE * file;								// Pointer to the audio file
-	float data[MAX_DATA_SAMPLES];				// Float audio values
-	float windowing_data[MAX_DATA_SAMPLES];		// Float windowing values
-	fftwf_complex fft_in[MAX_FRAME_SAMPLES];	// Complex audio values
-	fftwf_complex fft_out[MAX_FRAME_SAMPLES];	// Complex FFT values
+	fft_reader * reader;						// Decoder of the next frames,
+												// NULL if they are decoded
+												// when loaded
+	float * preload;							// Values of the whole file,
+												// NULL if it is not preloaded
+	size_t preload_values;						// Num. of preloaded values
+	size_t preload_pos;							// Next preloaded value loaded
+	int preload_locked;							// Whether "preload" is locked
+	float * data;								// Float audio values
+	const float * frame_data;					// Current frame values: "data"
+												// or the caller buffer
+	fft_decimator * analysis_decimator;			// Decimator of the analysed
+												// values, NULL if the full
+												// band is analysed
+	float * analysis_frame;						// Downmix of the frame values
+	float * analysis_data;						// Decimated frame values
+	float * ring;								// Last window of mono values,
+												// or of each channel values,
+												// NULL if windows don't overlap
+	float * windowing_bank;						// Values of every windowing
+	const float * windowing_data;				// Windowing values in use
+	float * fft_in;								// Real audio values
+	fft_backend_complex * fft_out;				// Complex FFT values
+	float * mag;								// Magnitudes of FFT values
+	double * mag_sum;							// Prefix sums of magnitudes
+
+	fft_backend_complex * channel_out;			// Complex FFT values of each
+												// channel, NULL if only the
+												// downmix is analysed
+	float * channel_mag;						// Magnitudes of each channel
+	double * channel_mag_sum;					// Prefix sums of each channel
+	fft_audio_stats * channel_stats;			// Statistics of each channel
+	float ** channel_ptrs;						// One buffer per channel
+
+	fft_backend_plan * lowres_plan;				// FFT plan of the bass window,
+												// NULL if it is disabled
+	fft_decimator * decimator;					// Decimator of the bass signal
+	float * lowres_frame;						// Downmix of the frame values
+	float * lowres_dec;							// Decimated frame values
+	float * lowres_ring;						// Last window of decimated vals
+	float * lowres_in;							// Real bass audio values
+	fft_backend_complex * lowres_out;			// Complex bass FFT values
+	float * lowres_mag;							// Magnitudes of bass values
+	double * lowres_mag_sum;					// Prefix sums of bass values
+	fft_audio_stats lowres_stats;				// Statistics of bass spectrum
+
+	fft_audio_engine engine;					// Engine allowed by config
+	int goertzel;								// Whether Goertzel is in use
+	double fft_cost;							// Estimated cost of the FFT
+	size_t * tracked_bins;						// Bins computed by Goertzel,
+												// NULL if it is not allowed
+	double * goertzel_coeffs;					// Coefficient of every bin
+	double * tracked_coeffs;					// Coefficient of each bin
+	double * tracked_state;						// Last two states of each bin
+	unsigned char * tracked_mask;				// Bins of the declared ranges
+	size_t tracked_count;						// Num. of bins computed
+
+	size_t * onset_edges;						// First bin of each onset band,
+												// NULL if onsets are disabled
+	float * onset_prev;							// Log energy of each band in
+												// the previous frame
+	size_t onset_bands;							// Num. of onset bands
+	size_t onset_hold;							// Frames between two onsets
+	size_t onset_wait;							// Frames until the next onset
+	size_t onset_frames;						// Frames in the flux averages
+	int onset_seeded;							// Whether "onset_prev" holds
+												// the energies of a frame
+	float onset_mean;							// Moving mean of the flux
+	float onset_dev;							// Moving mean deviation
+	fft_audio_onset onset;						// Onset of current frame
 
 	size_t samplerate;							// Samplerate of the audio file
 	size_t channels;							// Num. of channels of the audio
+	size_t analysis_factor;						// Decimation of analysed vals
 
 	size_t frame_samples;						// Num. of elems in a frame
+	size_t window_samples;						// Num. of elems in a window
+	size_t fft_samples;							// Num. of elems of the FFT
+	size_t spectrum_samples;					// Num. of non-redundant bins
+	size_t in_dist;								// Dist. of channel inputs
+	size_t out_dist;							// Dist. of channel spectra
+	size_t ring_pos;							// Oldest elem of the ring
+	size_t lowres_factor;						// Decimation of bass signal
+	size_t lowres_bins;							// Num. of bins served by the
+												// bass spectrum
+	size_t lowres_pos;							// Oldest elem of bass ring
 	fft_audio_windowing windowing;				// Windowing method
 	fft_audio_stats stats;						// Statistics of current frame
-} fft_audio;
+};
+
+struct fft_audio_filterbank {
+	fft_filterbank * fb;						// Filters of full-band spectrum
+	fft_filterbank * lowres_fb;					// Same filters on bass spectrum
+	fft_audio_range * ranges;					// Full-band bins of each band
+	size_t bands;								// Num. of bands
+};
 
 
 //------------------------------------------------------------------------------
@@ -60,130 +180,129 @@ static char * windowing_names[] = {
 	"Blackman"
 };
 
-static fft_audio audio;
+// The FFT planners are not thread safe: planning, wisdom and plan destruction
+// of every context are serialized by this mutex
+static pthread_mutex_t planner_mux = PTHREAD_MUTEX_INITIALIZER;
+
+// The context used by the single-stream functions
+static fft_audio_ctx * audio = NULL;
 
 
 //------------------------------------------------------------------------------
 //
-// This function calculates and stores the rectangular windowing data.
+// This function calculates and stores in "w" the rectangular windowing data.
 // Each element is calculated as follows:
 // w[i] = 1
 //
 //------------------------------------------------------------------------------
-static void fft_audio_fill_windowing_data_rectangular()
+static void fft_audio_fill_windowing_data_rectangular(float * w, const size_t N)
 {
 	size_t i;
-	const size_t N = audio.frame_samples;
 
 	for (i = 0; i < N; ++i) {
-		audio.windowing_data[i] = 1.0f;
+		w[i] = 1.0f;
 	}
 }
 
 
 //------------------------------------------------------------------------------
 //
-// This function calculates and stores the "Welch" windowing data.
+// This function calculates and stores in "w" the "Welch" windowing data.
 // Each element is calculated as follows:
 // w[i] = 1 - [(i - 0.5 * (N - 1)) / (0.5 * (N + 1))] ^ 2
 //
 //------------------------------------------------------------------------------
-static void fft_audio_fill_windowing_data_welch()
+static void fft_audio_fill_windowing_data_welch(float * w, const size_t N)
 {
 	size_t i;
-	const size_t N = audio.frame_samples;
 	float val;
 
 	for (i = 0; i < N; ++i) {
 		val = (i - 0.5f * (N - 1)) / (0.5f * N + 1);
-		audio.windowing_data[i] = 1.0f - val * val;
+		w[i] = 1.0f - val * val;
 	}
 }
 
 
 //------------------------------------------------------------------------------
 //
-// This function calculates and stores the "Triangular" windowing data.
+// This function calculates and stores in "w" the "Triangular" windowing data.
 // Each element is calculated as follows:
 // w[i] = (2 / N) * [(N / 2) - |i - (N / 2)|]
 //
 //------------------------------------------------------------------------------
-static void fft_audio_fill_windowing_data_triangular()
+static void fft_audio_fill_windowing_data_triangular(float * w, const size_t N)
 {
 	size_t i;
-	const size_t N = audio.frame_samples;
 	const float val = N / 2.0f;
 
 	for (i = 0; i < N; ++i) {
-		audio.windowing_data[i] = (val - fabsf(i - val)) / val;
+		w[i] = (val - fabsf(i - val)) / val;
 	}
 }
 
 
 //------------------------------------------------------------------------------
 //
-// This function calculates and stores the "Barlett" windowing data.
+// This function calculates and stores in "w" the "Barlett" windowing data.
 // Each element is calculated as follows:
 // w[i] = [2 / (N - 1)] * [(N - 1) / 2 - |i - (N - 1) / 2|]
 //
 //------------------------------------------------------------------------------
-static void fft_audio_fill_windowing_data_barlett()
+static void fft_audio_fill_windowing_data_barlett(float * w, const size_t N)
 {
 	size_t i;
-	const size_t N = audio.frame_samples;
 	const float val = (N - 1) / 2.0f;
 
 	for (i = 0; i < N; ++i) {
-		audio.windowing_data[i] = (val - fabsf(i - val)) / val;
+		w[i] = (val - fabsf(i - val)) / val;
 	}
 }
 
 
 //------------------------------------------------------------------------------
 //
-// This function calculates and stores the "Hanning" windowing data.
+// This function calculates and stores in "w" the "Hanning" windowing data.
 // Each element is calculated as follows:
 // w[i] = 0.5 * [1 - cos( (2 * pi * i) / (N - 1) )]
 //
 //------------------------------------------------------------------------------
-static void fft_audio_fill_windowing_data_hanning()
+static void fft_audio_fill_windowing_data_hanning(float * w, const size_t N)
 {
 	size_t i;
-	const size_t N = audio.frame_samples;
 	float val;
 
 	for (i = 0; i < N; ++i) {
 		val = cosf(2 * M_PI * i / (N - 1));
-		audio.windowing_data[i] = 0.5f * (1.0f - val);
+		w[i] = 0.5f * (1.0f - val);
 	}
 }
 
 
 //------------------------------------------------------------------------------
 //
-// This function calculates and stores the "Hamming" windowing data.
+// This function calculates and stores in "w" the "Hamming" windowing data.
 // Each element is calculated as follows:
 // a = 0.53836
 // b = 0.46164
 // w[i] = a - b * cos( (2 * pi * i) / (N - 1) )
 //
 //------------------------------------------------------------------------------
-static void fft_audio_fill_windowing_data_hamming()
+static void fft_audio_fill_windowing_data_hamming(float * w, const size_t N)
 {
 	size_t i;
-	const size_t N = audio.frame_samples;
 	float val;
 
 	for (i = 0; i < N; ++i) {
 		val = cosf(2 * M_PI * i / (N - 1));
-		audio.windowing_data[i] = 0.53836f - 0.46164f * val;
+		w[i] = 0.53836f - 0.46164f * val;
 	}
 }
 
 
 //------------------------------------------------------------------------------
 //
-// This function calculates and stores the "Blackman" windowing data.
+// This function calculates and stores in "w" the "Blackman" windowing data.
 // Each element is calculated as follows:
 // a = 0.42
 // b = 0.5
@@ -191,339 +310,2029 @@ static void fft_audio_fill_windowing_data_hamming()
 // w[i] = a - b * cos( (2 * pi * i) / (N - 1) + c * cos( (4 * pi * i) / (N - 1)
 //
 //------------------------------------------------------------------------------
-static void fft_audio_fill_windowing_data_blackman()
+static void fft_audio_fill_windowing_data_blackman(float * w, const size_t N)
 {
 	size_t i;
-	const size_t N = audio.frame_samples;
 	float val_one;
 	float val_two;
 
 	for (i = 0; i < N; ++i) {
 		val_one = cosf(2 * M_PI * i / (N - 1));
 		val_two = cosf(4 * M_PI * i / (N - 1));
-		audio.windowing_data[i] = 0.42f - 0.5f * val_one + 0.08f * val_two;
+		w[i] = 0.42f - 0.5f * val_one + 0.08f * val_two;
 	}
 }
 
 
+// The functions that fill the windowing data, indexed by windowing method
+static void (* const windowing_fills[])(float * w, const size_t N) = {
+	NULL,
+	fft_audio_fill_windowing_data_rectangular,
+	fft_audio_fill_windowing_data_welch,
+	fft_audio_fill_windowing_data_triangular,
+	fft_audio_fill_windowing_data_barlett,
+	fft_audio_fill_windowing_data_hanning,
+	fft_audio_fill_windowing_data_hamming,
+	fft_audio_fill_windowing_data_blackman
+};
+
+
 //------------------------------------------------------------------------------
 //
-// This function is a help function that allows to call the proper windowing
-// function that calculates and stores the windowing data.
+// This function is a help function that calculates, once per context, the
+// windowing data of every windowing method and stores them contiguously in the
+// windowing bank, so that changing windowing method is a pointer swap.
 //
 //------------------------------------------------------------------------------
-static void fft_audio_fill_windowing_data(const fft_audio_windowing windowing)
+static void fft_audio_fill_windowing_bank(fft_audio_ctx * ctx)
 {
-	switch (windowing) {
-		case fft_audio_rectangular:
-			fft_audio_fill_windowing_data_rectangular();
-			break;
-		case fft_audio_welch:
-			fft_audio_fill_windowing_data_welch();
-			break;
-		case fft_audio_triangular:
-			fft_audio_fill_windowing_data_triangular();
-			break;
-		case fft_audio_barlett:
-			fft_audio_fill_windowing_data_barlett();
-			break;
-		case fft_audio_hanning:
-			fft_audio_fill_windowing_data_hanning();
-			break;
-		case fft_audio_hamming:
-			fft_audio_fill_windowing_data_hamming();
-			break;
-		case fft_audio_blackman:
-			fft_audio_fill_windowing_data_blackman();
-			break;
-		default:
-			fft_audio_fill_windowing_data_rectangular();
-			break;
+	size_t i;
+	const size_t N = ctx->window_samples;
+
+	for (i = fft_audio_rectangular; i <= fft_audio_blackman; ++i) {
+		windowing_fills[i](ctx->windowing_bank + (i - 1) * N, N);
 	}
 }
 
 
 //------------------------------------------------------------------------------
 //
-// This function is a help function that applys the windowing to the current
-// frame.
+// This function is a help function that applys the windowing "w" to the "n"
+// values of a ring buffer, unrolled from its oldest value at "pos" in two
+// passes, storing the result in "in".
 //
 //------------------------------------------------------------------------------
-static void fft_audio_apply_window()
+static void fft_audio_window_ring(float * in,
+								  const float * ring,
+								  const size_t pos,
+								  const size_t n,
+								  const float * w)
 {
-	size_t i;
+	const size_t first = n - pos;
+
+	fft_kernels_downmix(in, ring + pos, w, first, 1, 1.0f);
+	fft_kernels_downmix(in + first, ring, w + first, pos, 1, 1.0f);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function is a help function that stores "count" values in a ring buffer
+// of "n" values, replacing the oldest ones starting at "pos", which is then
+// advanced. If there are more than "n" values, only the last "n" are stored.
+//
+//------------------------------------------------------------------------------
+static void fft_audio_ring_push(float * ring,
+								size_t * pos,
+								const size_t n,
+								const float * src,
+								size_t count)
+{
+	size_t chunk;
+
+	if (count > n) {
+		src += count - n;
+		count = n;
+	}
 
-	for (i = 0; i < audio.frame_samples; ++i) {
-		audio.fft_in[i][0] *= audio.windowing_data[i];
+	while (count > 0) {
+		chunk = MIN(count, n - *pos);
+		memcpy(ring + *pos, src, chunk * sizeof(float));
+		src += chunk;
+		count -= chunk;
+		*pos = (*pos + chunk) % n;
 	}
 }
 
 
 //------------------------------------------------------------------------------
 //
-// This function is a help function that allows to read the audio data of the
-// next frame. It also performs the numeric normalization of the audio signal
-// needed for the FFT execution.
+// This function is a help function that applys the windowing to the current
+// window of audio values, storing the result as FFT input.
+// If windows do not overlap, the window is the current frame: it is downmixed,
+// normalized and windowed in a single pass. Otherwise the ring buffer, already
+// downmixed and normalized, is unrolled from its oldest value in two passes.
+// When channels are analysed one by one, the same is done for each channel,
+// deinterleaving the frame instead of downmixing it.
 //
 //------------------------------------------------------------------------------
-static int fft_audio_read_next_frame_data()
+static void fft_audio_apply_window(fft_audio_ctx * ctx)
 {
-	size_t read_count;
 	size_t i;
-	size_t j;
-	size_t index;
-	float sum;
+	const float * w = ctx->windowing_data;
 
-	read_count = sf_read_float(audio.file,
-							   audio.data,
-							   audio.frame_samples * audio.channels);
-	if (read_count == 0) {
-		return FFT_AUDIO_EOF;
+	if (ctx->channel_out != NULL && ctx->ring == NULL) {
+		for (i = 0; i < ctx->channels; ++i) {
+			ctx->channel_ptrs[i] = ctx->fft_in + i * ctx->in_dist;
+		}
+		fft_kernels_deinterleave(ctx->channel_ptrs, ctx->frame_data, w,
+								 ctx->window_samples, ctx->channels,
+								 NORM_VALUE);
+		return;
 	}
 
-	for (i = 0; i < audio.frame_samples; ++i) {
-		sum = 0.0f;
-		for (j = 0; j < audio.channels; ++j) {
-			index = i * audio.channels + j;
-			if (index < read_count) {
-				sum += audio.data[index];
-			}
+	if (ctx->channel_out != NULL) {
+		for (i = 0; i < ctx->channels; ++i) {
+			fft_audio_window_ring(ctx->fft_in + i * ctx->in_dist,
+								  ctx->ring + i * ctx->window_samples,
+								  ctx->ring_pos, ctx->window_samples, w);
 		}
-		audio.fft_in[i][0] = sum * NORM_VALUE;
+		return;
 	}
 
-	return FFT_AUDIO_SUCCESS;
+	if (ctx->ring == NULL) {
+		fft_kernels_downmix(ctx->fft_in, ctx->frame_data, w,
+							ctx->window_samples, ctx->channels, NORM_VALUE);
+		return;
+	}
+
+	fft_audio_window_ring(ctx->fft_in, ctx->ring, ctx->ring_pos,
+						  ctx->window_samples, w);
 }
 
 
 //------------------------------------------------------------------------------
 //
-// This function initialize all data required to perform the FFT and to extract
-// statistics from an audio file.
-// It opens the file provided, initializes the audio data and the data needed to
-// perform the FFT.
+// This function is a help function that calculates the magnitude of each of the
+// "n" values of a spectrum and the statistics of the whole spectrum (DC value
+// excluded) with the vectorized kernel, then the prefix sums of the magnitudes:
+// mag_sum[i] = mag[0] + ... + mag[i - 1]
+// so that the average magnitude of any range costs O(1).
 //
 //------------------------------------------------------------------------------
-int fft_audio_init(const char filename[],
-				   const size_t duration)
+static void fft_audio_compute_magnitudes(const fft_backend_complex * out,
+										 float * mag,
+										 double * mag_sum,
+										 const size_t n,
+										 fft_audio_stats * stats)
 {
 	size_t i;
-	SF_INFO info;
+	double sum = 0.0;
+	fft_kernels_reduction reduction;
 
-	assert(filename != NULL);
-
-	memset(&info, 0, sizeof(info));
-	audio.file = sf_open(filename, SFM_READ, &info);
+	mag[0] = out[0][0] * out[0][0] + out[0][1] * out[0][1];
+	fft_kernels_magnitude(mag + 1, (const float (*)[2])(out + 1),
+						  n - 1, &reduction);
 
-	if (audio.file == NULL) {
-		return FFT_AUDIO_ERROR_FILE;
+	for (i = 0; i < n; ++i) {
+		mag_sum[i] = sum;
+		sum += mag[i];
 	}
+	mag_sum[n] = sum;
 
-	if (info.samplerate > MAX_SAMPLERATE) {
-		return FFT_AUDIO_ERROR_SAMPLERATE;
-	}
+	stats->magMin = reduction.min;
+	stats->magAvg = (sum - mag_sum[1]) / (n - 1);
+	stats->magMax = reduction.max;
+}
 
-	if (info.channels > MAX_CHANNELS) {
-		return FFT_AUDIO_ERROR_CHANNELS;
+
+//------------------------------------------------------------------------------
+//
+// This function is a help function that calculates, once per frame, the
+// magnitudes, prefix sums and statistics of the spectrum of the downmix and,
+// when channels are analysed one by one, of the spectrum of each channel.
+// In that case the spectrum of the downmix is the sum of the channel spectra.
+//
+//------------------------------------------------------------------------------
+static void fft_audio_compute_spectra(fft_audio_ctx * ctx)
+{
+	size_t i;
+	size_t j;
+	const fft_backend_complex * out;
+	const size_t n = ctx->spectrum_samples;
+
+	for (i = 0; ctx->channel_out != NULL && i < ctx->channels; ++i) {
+		out = (const fft_backend_complex *)ctx->channel_out +
+			  i * ctx->out_dist;
+		for (j = 0; j < n; ++j) {
+			ctx->fft_out[j][0] = (i == 0) ? out[j][0] :
+											ctx->fft_out[j][0] + out[j][0];
+			ctx->fft_out[j][1] = (i == 0) ? out[j][1] :
+											ctx->fft_out[j][1] + out[j][1];
+		}
+		fft_audio_compute_magnitudes(out,
+									 ctx->channel_mag + i * n,
+									 ctx->channel_mag_sum + i * (n + 1),
+									 n, ctx->channel_stats + i);
 	}
 
-	audio.samplerate = info.samplerate;
-	audio.channels = info.channels;
-	audio.windowing = -1;
-	audio.frame_samples = audio.samplerate / 1000.0 * duration;
+	fft_audio_compute_magnitudes((const fft_backend_complex *)ctx->fft_out,
+								 ctx->mag, ctx->mag_sum, n, &ctx->stats);
+}
+
 
-	assert(audio.frame_samples <= MAX_FRAME_SAMPLES);
+//------------------------------------------------------------------------------
+//
+// This function is a help function that calculates the magnitudes of the
+// tracked bins with the Goertzel algorithm, then the prefix sums of all the
+// magnitudes and the statistics of the tracked bins (DC value excluded).
+// For each bin k the recurrence runs on the window values only, since the
+// zero padding does not change the magnitude:
+// coeff = 2 * cos(2 * pi * k / N)
+// s[i] = x[i] + coeff * s[i - 1] - s[i - 2]
+// mag = s[W - 1] ^ 2 + s[W - 2] ^ 2 - coeff * s[W - 1] * s[W - 2]
+// The bins are updated together for each value, so that their independent
+// recurrences overlap. Doubles keep the low bins, whose coefficient is close
+// to 2, accurate.
+//
+//------------------------------------------------------------------------------
+static void fft_audio_compute_goertzel(fft_audio_ctx * ctx)
+{
+	size_t i;
+	size_t j;
+	double s0;
+	double sum = 0.0;
+	double sum_bins = 0.0;
+	size_t count_bins = 0;
+	float mag;
+	float magMin = FLT_MAX;
+	float magMax = FLT_MIN;
+	double * s1 = ctx->tracked_state;
+	double * s2 = ctx->tracked_state + ctx->spectrum_samples;
+	const double * coeffs = ctx->tracked_coeffs;
+	const size_t n = ctx->tracked_count;
+
+	for (j = 0; j < n; ++j) {
+		s1[j] = 0.0;
+		s2[j] = 0.0;
+	}
 
-	for (i = 0 ; i < MAX_DATA_SAMPLES; ++i) {
-		audio.data[i] = SILENCE_VALUE;
+	for (i = 0; i < ctx->window_samples; ++i) {
+		for (j = 0; j < n; ++j) {
+			s0 = ctx->fft_in[i] + coeffs[j] * s1[j] - s2[j];
+			s2[j] = s1[j];
+			s1[j] = s0;
+		}
 	}
 
-	for (i = 0; i < MAX_FRAME_SAMPLES; ++i) {
-		audio.fft_in[i][0] = SILENCE_VALUE;
-		audio.fft_in[i][1] = 0.0f;
-		audio.fft_out[i][0] = 0.0f;
-		audio.fft_out[i][1] = 0.0f;
+	for (j = 0; j < n; ++j) {
+		mag = s1[j] * s1[j] + s2[j] * s2[j] - coeffs[j] * s1[j] * s2[j];
+		ctx->mag[ctx->tracked_bins[j]] = mag;
+		if (ctx->tracked_bins[j] > 0) {
+			magMin = MIN(magMin, mag);
+			magMax = MAX(magMax, mag);
+			sum_bins += mag;
+			++count_bins;
+		}
 	}
 
-	audio.plan = fftwf_plan_dft_1d(audio.frame_samples,
-								   audio.fft_in,
-								   audio.fft_out,
-								   FFTW_FORWARD,
-								   FFTW_ESTIMATE);
+	for (i = 0; i < ctx->spectrum_samples; ++i) {
+		ctx->mag_sum[i] = sum;
+		sum += ctx->mag[i];
+	}
+	ctx->mag_sum[ctx->spectrum_samples] = sum;
 
-	return FFT_AUDIO_SUCCESS;
+	ctx->stats.magMin = magMin;
+	ctx->stats.magAvg = (count_bins > 0) ? sum_bins / count_bins : 0.0f;
+	ctx->stats.magMax = magMax;
 }
 
 
 //------------------------------------------------------------------------------
 //
-// This function returns the samplerate of the provided audio file.
+// This function is a help function that updates the onset detection with the
+// spectrum of the downmix of the current frame. The energy of each band is
+// its average magnitude, read from the prefix sums in O(1), converted to the
+// amplitude of a sinusoid relative to the full scale and log-compressed.
 //
 //------------------------------------------------------------------------------
-size_t fft_audio_get_samplerate()
+static void fft_audio_compute_onset(fft_audio_ctx * ctx)
 {
-	return audio.samplerate;
+	size_t i;
+	float energy;
+	float alpha;
+	float flux = 0.0f;
+	const size_t * edges = ctx->onset_edges;
+	const float scale = 2.0f / (ctx->fft_samples * NORM_VALUE);
+
+	for (i = 0; i < ctx->onset_bands; ++i) {
+		energy = (ctx->mag_sum[edges[i + 1]] - ctx->mag_sum[edges[i]]) /
+				 (edges[i + 1] - edges[i]);
+		energy = log1pf(ONSET_COMPRESSION * sqrtf(energy) * scale);
+		flux += MAX(energy - ctx->onset_prev[i], 0.0f);
+		ctx->onset_prev[i] = energy;
+	}
+	flux /= ctx->onset_bands;
+
+	// The first frame only seeds the band energies: its flux would be measured
+	// against the silence before the file, so it can never be an onset
+	if (!ctx->onset_seeded) {
+		ctx->onset_seeded = 1;
+		ctx->onset.flux = 0.0f;
+		ctx->onset.threshold = ONSET_MIN_FLUX;
+		ctx->onset.onset = 0;
+		return;
+	}
+
+	// The threshold does not include the current flux, so that a peak is not
+	// masked by itself
+	ctx->onset.flux = flux;
+	ctx->onset.threshold = ctx->onset_mean +
+						   ONSET_SENSITIVITY * ctx->onset_dev + ONSET_MIN_FLUX;
+	ctx->onset.onset = (ctx->onset_wait == 0 &&
+						flux > ctx->onset.threshold);
+
+	if (ctx->onset.onset) {
+		ctx->onset_wait = ctx->onset_hold;
+		return;
+	}
+
+	if (ctx->onset_wait > 0) {
+		--ctx->onset_wait;
+	}
+
+	// Onsets are not included, so that the threshold follows the flux of the
+	// background. Until there are enough frames, the plain mean is used.
+	++ctx->onset_frames;
+	alpha = MAX(ONSET_ALPHA, 1.0f / ctx->onset_frames);
+	ctx->onset_dev += alpha * (fabsf(flux - ctx->onset_mean) - ctx->onset_dev);
+	ctx->onset_mean += alpha * (flux - ctx->onset_mean);
 }
 
 
 //------------------------------------------------------------------------------
 //
-// This function returns the number of channels of the provided audio file.
+// This function is a help function that decodes up to "n" values of the audio
+// file of the context "ctx_ptr" into "dst": a PCM WAV file is converted from
+// its mapping, any other file is decoded by libsndfile. It also serves as the
+// decoder of the reader thread.
 //
 //------------------------------------------------------------------------------
-size_t fft_audio_get_channels()
+static size_t fft_audio_decode(void * ctx_ptr,
+							   float * dst,
+							   const size_t n)
 {
-	return audio.channels;
+	fft_audio_ctx * ctx = ctx_ptr;
+
+	if (ctx->wav != NULL) {
+		return fft_wav_read(ctx->wav, dst, n);
+	}
+
+	return sf_read_float(ctx->file, dst, n);
 }
 
 
 //------------------------------------------------------------------------------
 //
-// This function returns the number of samples in a frame.
+// This function is a help function that decodes the whole audio file of "ctx"
+// into the preload buffer, padded with silence to a whole number of frames,
+// then locks the buffer in memory and closes the file.
+// The "frames" declared by the file are only a hint: the file is decoded until
+// its end, and the buffer grows if the file is longer than declared or its
+// length is unknown. One more frame than declared is allocated, so that the
+// end of a file as long as declared is found without growing the buffer.
+// A file shorter than declared (e.g. truncated) just ends earlier: in any case
+// the values after its end, up to the end of its last frame, are silence.
 //
 //------------------------------------------------------------------------------
-size_t fft_audio_get_frame_samples()
+static int fft_audio_preload(fft_audio_ctx * ctx,
+							 const sf_count_t frames)
 {
-	return audio.frame_samples;
+	size_t i;
+	size_t size;
+	size_t count;
+	size_t read_count = 0;
+	float * grown;
+	const size_t data_samples = ctx->frame_samples * ctx->channels;
+
+	size = PRELOAD_FRAMES;
+	if (frames > 0 && (uint64_t)frames < SIZE_MAX / sizeof(float) /
+										 ctx->channels / 2) {
+		size = frames;
+	}
+	size = (ROUND_UP(size, ctx->frame_samples) + ctx->frame_samples) *
+		   ctx->channels;
+
+	ctx->preload = fft_backend_alloc_real(size);
+	if (ctx->preload == NULL) {
+		return FFT_AUDIO_ERROR_MEMORY;
+	}
+
+	do {
+		if (read_count == size) {
+			grown = fft_backend_alloc_real(2 * size);
+			if (grown == NULL) {
+				return FFT_AUDIO_ERROR_MEMORY;
+			}
+			memcpy(grown, ctx->preload, size * sizeof(float));
+			fft_backend_free(ctx->preload);
+			ctx->preload = grown;
+			size *= 2;
+		}
+		count = fft_audio_decode(ctx, ctx->preload + read_count,
+								 size - read_count);
+		read_count += count;
+	} while (count > 0);
+
+	ctx->preload_values = ROUND_UP(read_count, data_samples);
+	for (i = read_count; i < ctx->preload_values; ++i) {
+		ctx->preload[i] = SILENCE_VALUE;
+	}
+	ctx->preload_pos = 0;
+	ctx->preload_locked = mlock(ctx->preload,
+								ctx->preload_values * sizeof(float)) == 0;
+
+	fft_wav_close(ctx->wav);
+	ctx->wav = NULL;
+	if (ctx->file != NULL) {
+		sf_close(ctx->file);
+		ctx->file = NULL;
+	}
+
+	return FFT_AUDIO_SUCCESS;
 }
 
 
 //------------------------------------------------------------------------------
 //
-// This function returns the string name of the provided windowing.
+// This function is a help function that allows to read the audio data of the
+// next frame into "data", which becomes the current frame of the context: the
+// analysis reads it in place. With the reader thread, the frame is copied from
+// its ring instead of being decoded, and a frame not decoded yet is analysed
+// and played as silence. With a preloaded file, the current frame points into
+// the preloaded values, unless they have to be copied into the caller buffer
+// "data". The missing values of the last frame, or the whole frame at the end
+// of the file, are filled with silence.
+// If windows overlap, it also downmixes the new frame into the ring buffer,
+// performing the numeric normalization of the audio signal needed for the FFT
+// execution: only the values of the new frame replace the oldest ones. If the
+// frame is longer than the window, only its last window of values is stored.
+// When channels are analysed one by one, each channel has its own ring buffer.
+// If the analysed band is limited, the frame is first decimated to the analysis
+// samplerate: the downmix of the channels, or each channel when they are
+// analysed one by one. The frame values are kept at full rate for playback.
+// If the bass analysis is enabled, the downmix of the frame is also decimated
+// into the ring buffer of the bass window.
 //
 //------------------------------------------------------------------------------
-char * fft_audio_get_windowing_name(fft_audio_windowing windowing)
+static int fft_audio_read_next_frame_data(fft_audio_ctx * ctx,
+										  float * data)
 {
-	assert(fft_audio_rectangular <= windowing);
-	assert(windowing <= fft_audio_blackman);
+	size_t read_count;
+	size_t i;
+	size_t skip;
+	size_t count;
+	const float * frame;
+	size_t frame_count;
+	size_t frame_channels;
+	int ret = FFT_AUDIO_SUCCESS;
+	const size_t data_samples = ctx->frame_samples * ctx->channels;
+
+	if (ctx->reader != NULL) {
+		switch (fft_reader_pop(ctx->reader, data, &read_count)) {
+			case FFT_READER_UNDERRUN:
+				ret = FFT_AUDIO_UNDERRUN;
+				break;
+			case FFT_READER_EOF:
+				ret = FFT_AUDIO_EOF;
+				break;
+			default:
+				break;
+		}
+	} else if (ctx->preload != NULL) {
+		read_count = 0;
+		if (ctx->preload_pos < ctx->preload_values) {
+			read_count = data_samples;
+			if (data == ctx->data) {
+				data = ctx->preload + ctx->preload_pos;
+			} else {
+				memcpy(data, ctx->preload + ctx->preload_pos,
+					   data_samples * sizeof(float));
+			}
+			ctx->preload_pos += data_samples;
+		} else {
+			ret = FFT_AUDIO_EOF;
+		}
+	} else {
+		read_count = fft_audio_decode(ctx, data, data_samples);
+		if (read_count == 0) {
+			ret = FFT_AUDIO_EOF;
+		}
+	}
 
-	return windowing_names[windowing];
+	for (i = read_count; i < data_samples; ++i) {
+		data[i] = SILENCE_VALUE;
+	}
+
+	ctx->frame_data = data;
+	if (ret == FFT_AUDIO_EOF) {
+		return FFT_AUDIO_EOF;
+	}
+
+	frame = data;
+	frame_count = ctx->frame_samples;
+	frame_channels = ctx->channels;
+	if (ctx->analysis_decimator != NULL) {
+		if (ctx->channel_out == NULL) {
+			fft_kernels_downmix(ctx->analysis_frame, data, NULL,
+								ctx->frame_samples, ctx->channels, 1.0f);
+			frame = ctx->analysis_frame;
+			frame_channels = 1;
+		}
+		frame_count = fft_decimator_process(ctx->analysis_decimator,
+											ctx->analysis_data, frame,
+											ctx->frame_samples);
+		frame = ctx->analysis_data;
+	}
+
+	// The bass signal is scaled by sqrt(factor), so that the magnitudes of
+	// its spectrum have the same density of the full-band spectrum
+	if (ctx->lowres_plan != NULL) {
+		fft_kernels_downmix(ctx->lowres_frame, frame, NULL,
+							frame_count, frame_channels,
+							NORM_VALUE * sqrtf(ctx->lowres_factor));
+		count = fft_decimator_process(ctx->decimator, ctx->lowres_dec,
+									  ctx->lowres_frame, frame_count);
+		fft_audio_ring_push(ctx->lowres_ring, &ctx->lowres_pos,
+							ctx->window_samples, ctx->lowres_dec, count);
+	}
+
+	if (ctx->ring == NULL) {
+		return ret;
+	}
+
+	skip = 0;
+	if (frame_count > ctx->window_samples) {
+		skip = frame_count - ctx->window_samples;
+	}
+
+	while (skip < frame_count) {
+		count = MIN(frame_count - skip, ctx->window_samples - ctx->ring_pos);
+		if (ctx->channel_out != NULL) {
+			for (i = 0; i < ctx->channels; ++i) {
+				ctx->channel_ptrs[i] = ctx->ring + i * ctx->window_samples +
+									   ctx->ring_pos;
+			}
+			fft_kernels_deinterleave(ctx->channel_ptrs,
+									 frame + skip * frame_channels,
+									 NULL, count, frame_channels, NORM_VALUE);
+		} else {
+			fft_kernels_downmix(ctx->ring + ctx->ring_pos,
+								frame + skip * frame_channels,
+								NULL, count, frame_channels, NORM_VALUE);
+		}
+		skip += count;
+		ctx->ring_pos = (ctx->ring_pos + count) % ctx->window_samples;
+	}
+
+	return ret;
 }
 
 
+
 //------------------------------------------------------------------------------
 //
-// This function loads the next frame values from the provided audio file.
+// This function is a help function that returns the backend planning effort
+// corresponding to the provided planner effort.
 //
 //------------------------------------------------------------------------------
-int fft_audio_load_next_frame()
+static fft_backend_effort fft_audio_effort(const fft_audio_planner planner)
 {
-	int ret;
-
-	ret = fft_audio_read_next_frame_data();
-	if (ret == FFT_AUDIO_EOF) {
-		return FFT_AUDIO_EOF;
+	switch (planner) {
+		case fft_audio_measure:
+			return fft_backend_measure;
+		case fft_audio_patient:
+			return fft_backend_patient;
+		case fft_audio_estimate:
+		default:
+			return fft_backend_estimate;
 	}
-
-	return FFT_AUDIO_SUCCESS;
 }
 
 
 //------------------------------------------------------------------------------
 //
-// This function computes the FFT of the current frame values applying the
-// windowing method provided.
+// This function is a help function that returns the backend of the provided
+// kind, or the other one if it is not part of this build.
 //
 //------------------------------------------------------------------------------
-void fft_audio_compute_fft(fft_audio_windowing windowing)
+static fft_backend_type fft_audio_backend_type(const fft_audio_backend backend)
 {
-	assert(fft_audio_rectangular <= windowing);
-	assert(windowing <= fft_audio_blackman);
+	fft_backend_type type = fft_backend_fftw;
+
+	if (backend == fft_audio_backend_builtin) {
+		type = fft_backend_builtin;
+	}
 
-	if (audio.windowing != windowing) {
-		audio.windowing = windowing;
-		fft_audio_fill_windowing_data(windowing);
+	if (!fft_backend_is_available(type)) {
+		type = (type == fft_backend_fftw) ? fft_backend_builtin :
+											fft_backend_fftw;
 	}
-	fft_audio_apply_window();
-	fftwf_execute(audio.plan);
+
+	return type;
 }
 
 
 //------------------------------------------------------------------------------
 //
-// This function fill the provided "buffer" with current frame audio values.
+// This function is a help function that returns the decimation factor that
+// reduces "samplerate" the most while keeping "bandwidth" below the aliasing
+// limit of the decimation. Only the divisors of "samplerate" are considered,
+// so that the analysis samplerate is an integer too.
 //
 //------------------------------------------------------------------------------
-void fft_audio_fill_buffer_data(float * buffer)
+static size_t fft_audio_analysis_factor(const size_t samplerate,
+										const size_t bandwidth)
 {
-	size_t i;
+	size_t factor;
 
-	assert(buffer != NULL);
+	if (bandwidth == 0) {
+		return 1;
+	}
 
-	for (i = 0; i < audio.frame_samples * audio.channels; ++i) {
-		buffer[i] = audio.data[i];
+	factor = samplerate * FFT_DECIMATOR_PASSBAND / (2.0 * bandwidth);
+	while (factor > 1 && samplerate % factor != 0) {
+		--factor;
 	}
+
+	return MAX(factor, 1);
 }
 
 
 //------------------------------------------------------------------------------
 //
-// This function returns the statistics of the current FFT audio frame.
+// This function returns the default configuration used by fft_audio_init().
 //
 //------------------------------------------------------------------------------
-fft_audio_stats fft_audio_get_stats()
+fft_audio_config fft_audio_config_default()
 {
-	fft_audio_range range;
-
-	range.from = 1;
-	range.to = audio.frame_samples;
-	return fft_audio_get_stats_samples(range);
+	fft_audio_config config;
+
+	config.planner = fft_audio_estimate;
+	config.wisdom_filename = NULL;
+	config.hop_samples = 0;
+	config.window_samples = 0;
+	config.sizing = fft_audio_sizing_exact;
+	config.analysis = fft_audio_analysis_mono;
+	config.lowres_factor = 0;
+	config.engine = fft_audio_engine_auto;
+	config.analysis_bandwidth = 0;
+	config.onset_bands = 0;
+	config.backend = fft_audio_backend_fftw;
+	config.threads = 1;
+	config.threads_min_samples = THREADS_MIN_SAMPLES;
+	config.lookahead_frames = 0;
+	config.preload = 0;
+
+	return config;
 }
 
 
 //------------------------------------------------------------------------------
 //
-// This function returns the statistics of the FFT audio in the range of samples
-// [from, to]. It calculates the minimum, average and maximum magnitude of each
-// sample of the FFT in the current frame.
+// This function creates a new context and initializes all data required to
+// perform the FFT and to extract statistics from an audio file.
+// It opens the file provided, initializes the audio data and the data needed to
+// perform the FFT. The FFT is planned by the backend required by "config" with
+// the required effort, loading and saving the FFTW wisdom file if provided.
+// The file is then either preloaded or read ahead by the reader thread.
 //
 //------------------------------------------------------------------------------
-fft_audio_stats fft_audio_get_stats_samples(const fft_audio_range range)
+int fft_audio_ctx_init(fft_audio_ctx ** ctx_ptr,
+					   const char filename[],
+					   const size_t duration,
+					   const fft_audio_config * config)
 {
 	size_t i;
-	float real;
-	float imag;
-	float mag = 0.0f;
-	float magMin = FLT_MAX;
-	float magAvg = 0.0f;
-	float magMax = FLT_MIN;
-	fft_audio_stats stats;
+	size_t analysed;
+	int use_ring;
+	int ret;
+	size_t threads;
+	SF_INFO info;
+	fft_backend_type backend;
+	fft_backend_effort effort;
+	fft_audio_ctx * ctx;
+
+	assert(ctx_ptr != NULL);
+	assert(filename != NULL);
+	assert(config != NULL);
 
-	assert(range.from <= audio.frame_samples);
-	assert(range.to <= audio.frame_samples);
+	*ctx_ptr = NULL;
 
-	for (i = range.from; i < range.to; ++i) {
-		real = audio.fft_out[i][0];
-		imag = audio.fft_out[i][1];
+	ctx = calloc(1, sizeof(fft_audio_ctx));
+	if (ctx == NULL) {
+		return FFT_AUDIO_ERROR_MEMORY;
+	}
 
-		mag = real * real + imag * imag;
+	// Plain PCM WAV files are read straight from their mapping, the others are
+	// decoded by libsndfile
+	memset(&info, 0, sizeof(info));
+	if (fft_wav_open(&ctx->wav, filename) == FFT_WAV_SUCCESS) {
+		info.samplerate = fft_wav_get_samplerate(ctx->wav);
+		info.channels = fft_wav_get_channels(ctx->wav);
+		info.frames = fft_wav_get_frames(ctx->wav);
+	} else {
+		ctx->file = sf_open(filename, SFM_READ, &info);
+		if (ctx->file == NULL) {
+			fft_audio_ctx_free(ctx);
+			return FFT_AUDIO_ERROR_FILE;
+		}
+	}
 
-		magMin = MIN(magMin, mag);
-		magAvg += mag;
-		magMax = MAX(magMax, mag);
+	if (info.channels < 1) {
+		fft_audio_ctx_free(ctx);
+		return FFT_AUDIO_ERROR_CHANNELS;
 	}
 
-	stats.magMin = magMin;
-	stats.magAvg = magAvg / (range.to - range.from);
-	stats.magMax = magMax;
+	ctx->samplerate = info.samplerate;
+	ctx->channels = info.channels;
+	ctx->analysis_factor = fft_audio_analysis_factor(ctx->samplerate,
+													 config->analysis_bandwidth);
 
-	return stats;
-}
+	// Num. of signals transformed: the downmix or each channel
+	analysed = 1;
+	if (config->analysis == fft_audio_analysis_channels) {
+		analysed = ctx->channels;
+	}
+	ctx->windowing = -1;
+	ctx->frame_samples = config->hop_samples;
+	if (ctx->frame_samples == 0) {
+		ctx->frame_samples = ctx->samplerate / 1000.0 * duration;
+	}
 
+	// The window is expressed in samples at the analysis samplerate
+	ctx->window_samples = config->window_samples;
+	if (ctx->window_samples == 0) {
+		ctx->window_samples = ctx->frame_samples / ctx->analysis_factor;
+	}
 
-//------------------------------------------------------------------------------
-//
-// This function frees all data and data structures used.
-//
-//------------------------------------------------------------------------------
-void fft_audio_free()
-{
-	if (audio.file != NULL) {
-		sf_close(audio.file);
+	backend = fft_audio_backend_type(config->backend);
+	switch (config->sizing) {
+		case fft_audio_sizing_pad:
+			ctx->fft_samples = fft_backend_fast_size(backend,
+													 ctx->window_samples);
+			break;
+		case fft_audio_sizing_round:
+			ctx->window_samples = fft_backend_fast_size(backend,
+														ctx->window_samples);
+			ctx->fft_samples = ctx->window_samples;
+			break;
+		case fft_audio_sizing_exact:
+		default:
+			ctx->fft_samples = ctx->window_samples;
+			break;
+	}
+
+	ctx->spectrum_samples = ctx->fft_samples / 2 + 1;
+	ctx->ring_pos = 0;
+
+	// The bass spectrum serves the bins whose frequencies are not aliased by
+	// the decimation, "lowres_factor" times finer than the full-band ones
+	ctx->lowres_factor = config->lowres_factor;
+	ctx->lowres_bins = 0;
+	ctx->lowres_pos = 0;
+	if (ctx->lowres_factor > 1) {
+		ctx->lowres_bins = (ctx->spectrum_samples - 1) *
+						   FFT_DECIMATOR_PASSBAND / ctx->lowres_factor;
+	}
+
+	// Channel inputs and spectra are laid out one after the other, each one
+	// starting aligned for the SIMD FFT codelets
+	ctx->in_dist = ROUND_UP(ctx->fft_samples, ALIGN_SAMPLES);
+	ctx->out_dist = ROUND_UP(ctx->spectrum_samples, ALIGN_SAMPLES / 2);
+
+	if (ctx->frame_samples < MIN_FRAME_SAMPLES ||
+		ctx->window_samples < MIN_FRAME_SAMPLES) {
+		fft_audio_ctx_free(ctx);
+		return FFT_AUDIO_ERROR_SAMPLERATE;
+	}
+
+	// An exact length may not be supported by the built-in FFT, while FFTW
+	// may not be part of the build: the other backend is tried in that case
+	if (!fft_backend_supports(backend, ctx->fft_samples)) {
+		backend = (backend == fft_backend_fftw) ? fft_backend_builtin :
+												  fft_backend_fftw;
+	}
+
+	if (!fft_backend_supports(backend, ctx->fft_samples)) {
+		fft_audio_ctx_free(ctx);
+		return FFT_AUDIO_ERROR_BACKEND;
+	}
+
+	// Decimated frames are not a whole number of windows, so they always go
+	// through the ring buffer
+	use_ring = ctx->window_samples != ctx->frame_samples ||
+			   ctx->analysis_factor > 1;
+
+	// Buffers are sized to the frame and aligned for the SIMD FFT codelets
+	ctx->data = fft_backend_alloc_real(ctx->frame_samples * ctx->channels);
+	if (use_ring) {
+		ctx->ring = fft_backend_alloc_real(ctx->window_samples * analysed);
+	}
+	ctx->windowing_bank = fft_backend_alloc_real(fft_audio_blackman *
+												 ctx->window_samples);
+	ctx->fft_in = fft_backend_alloc_real(ctx->in_dist * analysed);
+	ctx->fft_out = fft_backend_alloc_complex(ctx->spectrum_samples);
+	ctx->mag = fft_backend_alloc_real(ctx->spectrum_samples);
+	ctx->mag_sum = fft_backend_malloc((ctx->spectrum_samples + 1) *
+									  sizeof(double));
+
+	if (config->analysis == fft_audio_analysis_channels) {
+		ctx->channel_out = fft_backend_alloc_complex(ctx->out_dist * analysed);
+		ctx->channel_mag = fft_backend_alloc_real(ctx->spectrum_samples *
+												  analysed);
+		ctx->channel_mag_sum = fft_backend_malloc((ctx->spectrum_samples + 1) *
+												  analysed * sizeof(double));
+		ctx->channel_stats = calloc(analysed, sizeof(fft_audio_stats));
+		ctx->channel_ptrs = calloc(analysed, sizeof(float *));
+	}
+
+	if (ctx->analysis_factor > 1) {
+		fft_decimator_init(&ctx->analysis_decimator, ctx->analysis_factor,
+						   analysed);
+		ctx->analysis_frame = fft_backend_alloc_real(ctx->frame_samples);
+		ctx->analysis_data = fft_backend_alloc_real((ctx->frame_samples /
+													 ctx->analysis_factor + 1) *
+													analysed);
+	}
+
+	if (ctx->lowres_bins > 0) {
+		fft_decimator_init(&ctx->decimator, ctx->lowres_factor, 1);
+		ctx->lowres_frame = fft_backend_alloc_real(ctx->frame_samples);
+		ctx->lowres_dec = fft_backend_alloc_real(ctx->frame_samples /
+												 ctx->lowres_factor + 1);
+		ctx->lowres_ring = fft_backend_alloc_real(ctx->window_samples);
+		ctx->lowres_in = fft_backend_alloc_real(ctx->fft_samples);
+		ctx->lowres_out = fft_backend_alloc_complex(ctx->spectrum_samples);
+		ctx->lowres_mag = fft_backend_alloc_real(ctx->spectrum_samples);
+		ctx->lowres_mag_sum = fft_backend_malloc((ctx->spectrum_samples + 1) *
+												 sizeof(double));
+	}
+
+	// Goertzel computes the downmix only, so per-channel analysis needs the FFT,
+	// and only the declared bands, so onset detection needs the FFT too
+	ctx->engine = config->engine;
+	if (config->analysis == fft_audio_analysis_channels ||
+		config->onset_bands > 0) {
+		ctx->engine = fft_audio_engine_fft;
+	}
+
+	// Each onset band covers at least one bin, DC value excluded
+	ctx->onset_bands = MIN(config->onset_bands, ctx->spectrum_samples - 1);
+	if (ctx->onset_bands > 0) {
+		ctx->onset_edges = malloc((ctx->onset_bands + 1) * sizeof(size_t));
+		ctx->onset_prev = malloc(ctx->onset_bands * sizeof(float));
+	}
+
+	if (ctx->engine != fft_audio_engine_fft) {
+		ctx->tracked_bins = malloc(ctx->spectrum_samples * sizeof(size_t));
+		ctx->goertzel_coeffs = malloc(ctx->spectrum_samples * sizeof(double));
+		ctx->tracked_coeffs = malloc(ctx->spectrum_samples * sizeof(double));
+		ctx->tracked_state = malloc(2 * ctx->spectrum_samples *
+									sizeof(double));
+		ctx->tracked_mask = calloc(ctx->spectrum_samples, 1);
+	}
+
+	if (ctx->data == NULL ||
+		(ctx->ring == NULL && use_ring) ||
+		(ctx->analysis_factor > 1 &&
+		 (ctx->analysis_decimator == NULL || ctx->analysis_frame == NULL ||
+		  ctx->analysis_data == NULL)) ||
+		ctx->windowing_bank == NULL ||
+		ctx->fft_in == NULL || ctx->fft_out == NULL ||
+		ctx->mag == NULL || ctx->mag_sum == NULL ||
+		(config->analysis == fft_audio_analysis_channels &&
+		 (ctx->channel_out == NULL || ctx->channel_mag == NULL ||
+		  ctx->channel_mag_sum == NULL || ctx->channel_stats == NULL ||
+		  ctx->channel_ptrs == NULL)) ||
+		(ctx->lowres_bins > 0 &&
+		 (ctx->decimator == NULL || ctx->lowres_frame == NULL ||
+		  ctx->lowres_dec == NULL || ctx->lowres_ring == NULL ||
+		  ctx->lowres_in == NULL || ctx->lowres_out == NULL ||
+		  ctx->lowres_mag == NULL || ctx->lowres_mag_sum == NULL)) ||
+		(ctx->engine != fft_audio_engine_fft &&
+		 (ctx->tracked_bins == NULL || ctx->goertzel_coeffs == NULL ||
+		  ctx->tracked_coeffs == NULL ||
+		  ctx->tracked_state == NULL || ctx->tracked_mask == NULL)) ||
+		(ctx->onset_bands > 0 &&
+		 (ctx->onset_edges == NULL || ctx->onset_prev == NULL))) {
+		fft_audio_ctx_free(ctx);
+		return FFT_AUDIO_ERROR_MEMORY;
+	}
+
+	effort = fft_audio_effort(config->planner);
+
+	// Only long FFTs are split among threads, short ones would spend more time
+	// waking them up than transforming
+	threads = 1;
+	if (ctx->fft_samples >= config->threads_min_samples) {
+		threads = config->threads;
+	}
+
+	pthread_mutex_lock(&planner_mux);
+
+	// A previously stored plan makes the planning below immediate
+	if (config->wisdom_filename != NULL) {
+		fft_backend_import_wisdom(config->wisdom_filename);
+	}
+
+	// The input is real, so only the N / 2 + 1 non-redundant bins are computed.
+	// Channels are transformed by a single batched plan, sharing its setup.
+	if (ctx->channel_out != NULL) {
+		ret = fft_backend_plan_init(&ctx->plan, backend, ctx->fft_samples,
+									ctx->channels,
+									ctx->fft_in, ctx->in_dist,
+									ctx->channel_out, ctx->out_dist,
+									effort, threads);
+	} else {
+		ret = fft_backend_plan_init(&ctx->plan, backend, ctx->fft_samples, 1,
+									ctx->fft_in, ctx->in_dist,
+									ctx->fft_out, ctx->out_dist,
+									effort, threads);
+	}
+
+	// The bass FFT has the same length, so it reuses the planning above
+	if (ret == FFT_BACKEND_SUCCESS && ctx->lowres_bins > 0) {
+		ret = fft_backend_plan_init(&ctx->lowres_plan, backend,
+									ctx->fft_samples, 1,
+									ctx->lowres_in, ctx->in_dist,
+									ctx->lowres_out, ctx->out_dist,
+									effort, threads);
+	}
+
+	if (ret == FFT_BACKEND_SUCCESS && config->wisdom_filename != NULL) {
+		fft_backend_export_wisdom(config->wisdom_filename);
+	}
+
+	pthread_mutex_unlock(&planner_mux);
+
+	if (ret != FFT_BACKEND_SUCCESS) {
+		fft_audio_ctx_free(ctx);
+		return FFT_AUDIO_ERROR_BACKEND;
+	}
+
+	// Planning may overwrite the arrays, so they are cleared only afterwards
+	for (i = 0 ; i < ctx->frame_samples * ctx->channels; ++i) {
+		ctx->data[i] = SILENCE_VALUE;
 	}
+	ctx->frame_data = ctx->data;
 
-	if (audio.plan != NULL) {
-		fftwf_destroy_plan(audio.plan);
+	for (i = 0; ctx->ring != NULL && i < ctx->window_samples * analysed; ++i) {
+		ctx->ring[i] = SILENCE_VALUE;
 	}
+
+	// Every windowing method is computed here, out of the real-time path
+	fft_audio_fill_windowing_bank(ctx);
+
+	// So are the Goertzel coefficients of every bin, see
+	// fft_audio_compute_goertzel(), and the cost of the FFT, so that
+	// fft_audio_ctx_set_bands() needs no math library call
+	ctx->fft_cost = FFT_STEP_COST * ctx->fft_samples * log2(ctx->fft_samples);
+	if (ctx->goertzel_coeffs != NULL) {
+		for (i = 0; i < ctx->spectrum_samples; ++i) {
+			ctx->goertzel_coeffs[i] = 2.0 * cos(2.0 * M_PI * i /
+												ctx->fft_samples);
+		}
+	}
+
+	// The values after the window are the zero padding, never overwritten
+	for (i = 0; i < ctx->in_dist * analysed; ++i) {
+		ctx->fft_in[i] = SILENCE_VALUE;
+	}
+
+	for (i = 0; i < ctx->spectrum_samples; ++i) {
+		ctx->fft_out[i][0] = 0.0f;
+		ctx->fft_out[i][1] = 0.0f;
+	}
+
+	for (i = 0; ctx->channel_out != NULL && i < ctx->out_dist * analysed; ++i) {
+		ctx->channel_out[i][0] = 0.0f;
+		ctx->channel_out[i][1] = 0.0f;
+	}
+
+	if (ctx->lowres_plan != NULL) {
+		for (i = 0; i < ctx->window_samples; ++i) {
+			ctx->lowres_ring[i] = SILENCE_VALUE;
+		}
+		for (i = 0; i < ctx->fft_samples; ++i) {
+			ctx->lowres_in[i] = SILENCE_VALUE;
+		}
+		for (i = 0; i < ctx->spectrum_samples; ++i) {
+			ctx->lowres_out[i][0] = 0.0f;
+			ctx->lowres_out[i][1] = 0.0f;
+		}
+		fft_audio_compute_magnitudes((const fft_backend_complex *)
+									 ctx->lowres_out,
+									 ctx->lowres_mag, ctx->lowres_mag_sum,
+									 ctx->spectrum_samples,
+									 &ctx->lowres_stats);
+	}
+	fft_audio_compute_spectra(ctx);
+
+	// Onset bands are equally spaced on a logarithmic scale between the first
+	// bin and the end of the spectrum, leaving room for the next ones
+	if (ctx->onset_edges != NULL) {
+		ctx->onset_edges[0] = 1;
+		for (i = 1; i <= ctx->onset_bands; ++i) {
+			ctx->onset_edges[i] = lround(pow(ctx->spectrum_samples,
+											 (double)i / ctx->onset_bands));
+			ctx->onset_edges[i] = MAX(ctx->onset_edges[i],
+									  ctx->onset_edges[i - 1] + 1);
+			ctx->onset_edges[i] = MIN(ctx->onset_edges[i],
+									  ctx->spectrum_samples -
+									  (ctx->onset_bands - i));
+		}
+		for (i = 0; i < ctx->onset_bands; ++i) {
+			ctx->onset_prev[i] = 0.0f;
+		}
+		ctx->onset_hold = ONSET_HOLD_MS * ctx->samplerate /
+						  (1000 * ctx->frame_samples);
+	}
+
+	// A preloaded file needs no reader thread, its frames are already decoded
+	if (config->preload) {
+		ret = fft_audio_preload(ctx, info.frames);
+		if (ret != FFT_AUDIO_SUCCESS) {
+			fft_audio_ctx_free(ctx);
+			return ret;
+		}
+	}
+
+	// From now on the file is read by the reader thread only
+	if (ctx->preload == NULL && config->lookahead_frames > 0 &&
+		fft_reader_init(&ctx->reader, fft_audio_decode, ctx,
+						ctx->frame_samples * ctx->channels,
+						config->lookahead_frames) != FFT_READER_SUCCESS) {
+		fft_audio_ctx_free(ctx);
+		return FFT_AUDIO_ERROR_MEMORY;
+	}
+
+	*ctx_ptr = ctx;
+	return FFT_AUDIO_SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the samplerate of the audio file of the context.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_ctx_get_samplerate(const fft_audio_ctx * ctx)
+{
+	assert(ctx != NULL);
+
+	return ctx->samplerate;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the number of channels of the audio file of the
+// context.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_ctx_get_channels(const fft_audio_ctx * ctx)
+{
+	assert(ctx != NULL);
+
+	return ctx->channels;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the samplerate of the values analysed by the FFT of
+// the context.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_ctx_get_analysis_samplerate(const fft_audio_ctx * ctx)
+{
+	assert(ctx != NULL);
+
+	return ctx->samplerate / ctx->analysis_factor;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the number of samples in a frame of the context.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_ctx_get_frame_samples(const fft_audio_ctx * ctx)
+{
+	assert(ctx != NULL);
+
+	return ctx->frame_samples;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the number of samples analysed by the FFT of the
+// context.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_ctx_get_window_samples(const fft_audio_ctx * ctx)
+{
+	assert(ctx != NULL);
+
+	return ctx->window_samples;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the length of the FFT of the context.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_ctx_get_fft_samples(const fft_audio_ctx * ctx)
+{
+	assert(ctx != NULL);
+
+	return ctx->fft_samples;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the number of non-redundant samples of the spectrum of
+// the context.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_ctx_get_spectrum_samples(const fft_audio_ctx * ctx)
+{
+	assert(ctx != NULL);
+
+	return ctx->spectrum_samples;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the string name of the provided windowing.
+//
+//------------------------------------------------------------------------------
+char * fft_audio_get_windowing_name(fft_audio_windowing windowing)
+{
+	assert(fft_audio_rectangular <= windowing);
+	assert(windowing <= fft_audio_blackman);
+
+	return windowing_names[windowing];
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function loads the next frame values from the audio file of the context.
+//
+//------------------------------------------------------------------------------
+int fft_audio_ctx_load_next_frame(fft_audio_ctx * ctx)
+{
+	assert(ctx != NULL);
+
+	return fft_audio_read_next_frame_data(ctx, ctx->data);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function loads the next frame values from the audio file of the context
+// straight into the provided buffer, which the analysis then reads in place.
+//
+//------------------------------------------------------------------------------
+int fft_audio_ctx_load_next_frame_into(fft_audio_ctx * ctx,
+									   float * buffer)
+{
+	assert(ctx != NULL);
+	assert(buffer != NULL);
+
+	return fft_audio_read_next_frame_data(ctx, buffer);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function declares the "n" ranges whose statistics will be requested,
+// and chooses the engine that computes the spectrum of the downmix of the
+// context: the bins of the ranges not served by the bass spectrum are
+// collected, and the Goertzel algorithm is used if allowed and, with
+// fft_audio_engine_auto, if its estimated cost is lower than the FFT one.
+//
+//------------------------------------------------------------------------------
+void fft_audio_ctx_set_bands(fft_audio_ctx * ctx,
+							 const fft_audio_range ranges[],
+							 const size_t n)
+{
+	size_t i;
+	size_t j;
+	double goertzel_cost;
+	int goertzel;
+
+	assert(ctx != NULL);
+	assert(n == 0 || ranges != NULL);
+
+	if (ctx->tracked_bins == NULL) {
+		return;
+	}
+
+	// Only the bins tracked so far are unmarked, and their magnitudes cleared
+	// while Goertzel is in use, instead of scanning the whole spectrum
+	for (j = 0; j < ctx->tracked_count; ++j) {
+		ctx->tracked_mask[ctx->tracked_bins[j]] = 0;
+		if (ctx->goertzel) {
+			ctx->mag[ctx->tracked_bins[j]] = 0.0f;
+		}
+	}
+
+	// Bins are tracked in the order of the ranges, each one once even if
+	// ranges overlap
+	ctx->tracked_count = 0;
+	for (i = 0; i < n; ++i) {
+		assert(ranges[i].to <= ctx->spectrum_samples);
+		if (ranges[i].from < ranges[i].to && ranges[i].to <= ctx->lowres_bins) {
+			continue;
+		}
+		for (j = ranges[i].from; j < ranges[i].to; ++j) {
+			if (!ctx->tracked_mask[j]) {
+				ctx->tracked_mask[j] = 1;
+				ctx->tracked_bins[ctx->tracked_count] = j;
+				ctx->tracked_coeffs[ctx->tracked_count] =
+					ctx->goertzel_coeffs[j];
+				++ctx->tracked_count;
+			}
+		}
+	}
+
+	goertzel_cost = GOERTZEL_STEP_COST * ctx->window_samples *
+					ctx->tracked_count;
+
+	goertzel = (ctx->tracked_count > 0 &&
+				(ctx->engine == fft_audio_engine_goertzel ||
+				 goertzel_cost < ctx->fft_cost));
+
+	// The magnitudes of the bins not tracked are 0 from now on: the whole
+	// spectrum is cleared only when switching from the FFT
+	if (goertzel && !ctx->goertzel) {
+		for (j = 0; j < ctx->spectrum_samples; ++j) {
+			ctx->mag[j] = 0.0f;
+		}
+	}
+	ctx->goertzel = goertzel;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the engine that computes the spectrum of the downmix
+// of the context.
+//
+//------------------------------------------------------------------------------
+fft_audio_engine fft_audio_ctx_get_engine(const fft_audio_ctx * ctx)
+{
+	assert(ctx != NULL);
+
+	return ctx->goertzel ? fft_audio_engine_goertzel : fft_audio_engine_fft;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function computes the FFT of the current frame values of the context
+// applying the windowing method provided.
+//
+//------------------------------------------------------------------------------
+void fft_audio_ctx_compute_fft(fft_audio_ctx * ctx,
+							   fft_audio_windowing windowing)
+{
+	assert(ctx != NULL);
+	assert(fft_audio_rectangular <= windowing);
+	assert(windowing <= fft_audio_blackman);
+
+	if (ctx->windowing != windowing) {
+		ctx->windowing = windowing;
+		ctx->windowing_data = ctx->windowing_bank +
+							  (windowing - 1) * ctx->window_samples;
+	}
+	fft_audio_apply_window(ctx);
+	if (ctx->goertzel) {
+		fft_audio_compute_goertzel(ctx);
+	} else {
+		fft_backend_execute(ctx->plan);
+		fft_audio_compute_spectra(ctx);
+	}
+
+	if (ctx->onset_edges != NULL) {
+		fft_audio_compute_onset(ctx);
+	}
+
+	if (ctx->lowres_plan != NULL) {
+		fft_audio_window_ring(ctx->lowres_in, ctx->lowres_ring,
+							  ctx->lowres_pos, ctx->window_samples,
+							  ctx->windowing_data);
+		fft_backend_execute(ctx->lowres_plan);
+		fft_audio_compute_magnitudes((const fft_backend_complex *)
+									 ctx->lowres_out,
+									 ctx->lowres_mag, ctx->lowres_mag_sum,
+									 ctx->spectrum_samples,
+									 &ctx->lowres_stats);
+	}
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function fill the provided "buffer" with current frame audio values of
+// the context. Nothing is copied if the frame was loaded into "buffer".
+//
+//------------------------------------------------------------------------------
+void fft_audio_ctx_fill_buffer_data(const fft_audio_ctx * ctx,
+									float * buffer)
+{
+	assert(ctx != NULL);
+	assert(buffer != NULL);
+
+	if (buffer != ctx->frame_data) {
+		memcpy(buffer, ctx->frame_data,
+			   ctx->frame_samples * ctx->channels * sizeof(float));
+	}
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the statistics of the current FFT audio frame of the
+// context, calculated once per frame right after the FFT.
+//
+//------------------------------------------------------------------------------
+fft_audio_stats fft_audio_ctx_get_stats(const fft_audio_ctx * ctx)
+{
+	assert(ctx != NULL);
+
+	return ctx->stats;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function is a help function that calculates the statistics of the "n"
+// magnitudes of a spectrum in the range of samples [from, to], all 0 if the
+// range is empty.
+// The average is obtained in O(1) from the prefix sums of the magnitudes,
+// while the minimum and the maximum are searched in the magnitudes.
+//
+//------------------------------------------------------------------------------
+static fft_audio_stats fft_audio_range_stats(const float * mag,
+											 const double * mag_sum,
+											 const size_t n,
+											 const fft_audio_range range)
+{
+	size_t i;
+	float magMin = FLT_MAX;
+	float magMax = FLT_MIN;
+	fft_audio_stats stats;
+
+	assert(range.from <= range.to);
+	assert(range.to <= n);
+
+	// An empty range has no magnitudes: its statistics are all 0
+	if (range.from == range.to) {
+		stats.magMin = 0.0f;
+		stats.magAvg = 0.0f;
+		stats.magMax = 0.0f;
+		return stats;
+	}
+
+	for (i = range.from; i < range.to; ++i) {
+		magMin = MIN(magMin, mag[i]);
+		magMax = MAX(magMax, mag[i]);
+	}
+
+	stats.magMin = magMin;
+	stats.magAvg = (mag_sum[range.to] - mag_sum[range.from]) /
+				   (range.to - range.from);
+	stats.magMax = magMax;
+
+	return stats;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function is a help function that calculates the statistics of the
+// downmix in the range of samples [from, to] from the finest spectrum that
+// covers it: ranges entirely below the bass limit are read from the bass
+// spectrum, at "lowres_factor" bins per full-band bin.
+//
+//------------------------------------------------------------------------------
+static fft_audio_stats fft_audio_band_range_stats(const fft_audio_ctx * ctx,
+												  const fft_audio_range range)
+{
+	fft_audio_range lowres;
+
+	if (range.from < range.to && range.to <= ctx->lowres_bins) {
+		lowres.from = range.from * ctx->lowres_factor;
+		lowres.to = range.to * ctx->lowres_factor;
+		return fft_audio_range_stats(ctx->lowres_mag, ctx->lowres_mag_sum,
+									 ctx->spectrum_samples, lowres);
+	}
+
+	return fft_audio_range_stats(ctx->mag, ctx->mag_sum,
+								 ctx->spectrum_samples, range);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the statistics of the FFT audio of the context in the
+// range of samples [from, to]. It calculates the minimum, average and maximum
+// magnitude of each sample of the FFT in the current frame.
+//
+//------------------------------------------------------------------------------
+fft_audio_stats fft_audio_ctx_get_stats_samples(const fft_audio_ctx * ctx,
+												const fft_audio_range range)
+{
+	assert(ctx != NULL);
+
+	return fft_audio_band_range_stats(ctx, range);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function fills "stats" with the statistics of the FFT audio of the
+// context in each of the "n" provided ranges, one range after the other.
+// Sorted and disjoint ranges naturally read each magnitude once.
+//
+//------------------------------------------------------------------------------
+void fft_audio_ctx_get_band_stats(const fft_audio_ctx * ctx,
+								  const fft_audio_range ranges[],
+								  const size_t n,
+								  fft_audio_stats stats[])
+{
+	size_t i;
+
+	assert(ctx != NULL);
+	assert(n == 0 || ranges != NULL);
+	assert(n == 0 || stats != NULL);
+
+	for (i = 0; i < n; ++i) {
+		stats[i] = fft_audio_band_range_stats(ctx, ranges[i]);
+	}
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function creates the perceptual bands of the spectra of the context.
+// The bass spectrum has the same length of the full-band one at a samplerate
+// "lowres_factor" times lower, so the same edges give its own filterbank.
+//
+//------------------------------------------------------------------------------
+int fft_audio_ctx_filterbank_init(const fft_audio_ctx * ctx,
+								  fft_audio_filterbank ** afb_ptr,
+								  const fft_filterbank_scale scale,
+								  const size_t bands,
+								  const float min_freq,
+								  const float max_freq)
+{
+	size_t i;
+	size_t count;
+	size_t samplerate;
+	int ret;
+	fft_audio_filterbank * afb;
+
+	assert(ctx != NULL);
+	assert(afb_ptr != NULL);
+
+	samplerate = ctx->samplerate / ctx->analysis_factor;
+	assert(max_freq <= samplerate / 2.0f);
+
+	*afb_ptr = NULL;
+
+	afb = calloc(1, sizeof(fft_audio_filterbank));
+	if (afb == NULL) {
+		return FFT_AUDIO_ERROR_MEMORY;
+	}
+
+	afb->bands = bands;
+	afb->ranges = malloc(bands * sizeof(fft_audio_range));
+	ret = fft_filterbank_init(&afb->fb, scale, bands, min_freq, max_freq,
+							  ctx->fft_samples, samplerate);
+	if (ret == FFT_FILTERBANK_SUCCESS && ctx->lowres_bins > 0) {
+		ret = fft_filterbank_init(&afb->lowres_fb, scale, bands,
+								  min_freq, max_freq, ctx->fft_samples,
+								  (float)samplerate / ctx->lowres_factor);
+	}
+	if (ret != FFT_FILTERBANK_SUCCESS || afb->ranges == NULL) {
+		fft_audio_filterbank_free(afb);
+		return FFT_AUDIO_ERROR_MEMORY;
+	}
+
+	for (i = 0; i < bands; ++i) {
+		count = fft_filterbank_get_bins(afb->fb, i, &afb->ranges[i].from);
+		afb->ranges[i].to = afb->ranges[i].from + count;
+	}
+
+	*afb_ptr = afb;
+	return FFT_AUDIO_SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the ranges of full-band samples covered by the bands.
+//
+//------------------------------------------------------------------------------
+const fft_audio_range * fft_audio_filterbank_get_ranges(
+	const fft_audio_filterbank * afb)
+{
+	assert(afb != NULL);
+
+	return afb->ranges;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function fills "values" with the value of each band of the context. A
+// band is read from the bass spectrum under the same condition of its range
+// in fft_audio_ctx_set_bands(), so that the Goertzel engine computes exactly
+// the full-band bins the other bands read.
+//
+//------------------------------------------------------------------------------
+void fft_audio_ctx_get_filterbank_values(const fft_audio_ctx * ctx,
+										 const fft_audio_filterbank * afb,
+										 float values[])
+{
+	size_t i;
+
+	assert(ctx != NULL);
+	assert(afb != NULL);
+	assert(values != NULL);
+	assert(ctx->lowres_bins == 0 || afb->lowres_fb != NULL);
+
+	for (i = 0; i < afb->bands; ++i) {
+		if (afb->ranges[i].to <= ctx->lowres_bins) {
+			values[i] = fft_filterbank_apply_band(afb->lowres_fb,
+												  ctx->lowres_mag, i);
+		} else {
+			values[i] = fft_filterbank_apply_band(afb->fb, ctx->mag, i);
+		}
+	}
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function frees all data and data structures used by the bands.
+//
+//------------------------------------------------------------------------------
+void fft_audio_filterbank_free(fft_audio_filterbank * afb)
+{
+	if (afb == NULL) {
+		return;
+	}
+
+	fft_filterbank_free(afb->fb);
+	fft_filterbank_free(afb->lowres_fb);
+	free(afb->ranges);
+	free(afb);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the magnitudes of the full-band spectrum of the
+// downmix of the context.
+//
+//------------------------------------------------------------------------------
+const float * fft_audio_ctx_get_magnitudes(const fft_audio_ctx * ctx)
+{
+	assert(ctx != NULL);
+
+	return ctx->mag;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the onset detection of the current frame of the
+// context.
+//
+//------------------------------------------------------------------------------
+fft_audio_onset fft_audio_ctx_get_onset(const fft_audio_ctx * ctx)
+{
+	assert(ctx != NULL);
+	assert(ctx->onset_edges != NULL);
+
+	return ctx->onset;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the statistics of the current FFT audio frame of one
+// channel of the context, calculated once per frame right after the FFT.
+//
+//------------------------------------------------------------------------------
+fft_audio_stats fft_audio_ctx_get_channel_stats(const fft_audio_ctx * ctx,
+												const size_t channel)
+{
+	assert(ctx != NULL);
+	assert(ctx->channel_out != NULL);
+	assert(channel < ctx->channels);
+
+	return ctx->channel_stats[channel];
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function fills "stats" with the statistics of one channel of the context
+// in each of the "n" provided ranges.
+//
+//------------------------------------------------------------------------------
+void fft_audio_ctx_get_channel_band_stats(const fft_audio_ctx * ctx,
+										  const size_t channel,
+										  const fft_audio_range ranges[],
+										  const size_t n,
+										  fft_audio_stats stats[])
+{
+	size_t i;
+	const float * mag;
+	const double * mag_sum;
+
+	assert(ctx != NULL);
+	assert(ctx->channel_out != NULL);
+	assert(channel < ctx->channels);
+	assert(n == 0 || ranges != NULL);
+	assert(n == 0 || stats != NULL);
+
+	mag = ctx->channel_mag + channel * ctx->spectrum_samples;
+	mag_sum = ctx->channel_mag_sum + channel * (ctx->spectrum_samples + 1);
+
+	for (i = 0; i < n; ++i) {
+		stats[i] = fft_audio_range_stats(mag, mag_sum,
+										 ctx->spectrum_samples, ranges[i]);
+	}
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function frees all data and data structures used by the context.
+//
+//------------------------------------------------------------------------------
+void fft_audio_ctx_free(fft_audio_ctx * ctx)
+{
+	if (ctx == NULL) {
+		return;
+	}
+
+	// The reader thread is stopped before its file is closed
+	fft_reader_free(ctx->reader);
+	fft_wav_close(ctx->wav);
+	if (ctx->file != NULL) {
+		sf_close(ctx->file);
+	}
+
+	pthread_mutex_lock(&planner_mux);
+	fft_backend_plan_free(ctx->plan);
+	fft_backend_plan_free(ctx->lowres_plan);
+	pthread_mutex_unlock(&planner_mux);
+
+	if (ctx->preload_locked) {
+		munlock(ctx->preload, ctx->preload_values * sizeof(float));
+	}
+	fft_backend_free(ctx->preload);
+	fft_backend_free(ctx->data);
+	fft_decimator_free(ctx->analysis_decimator);
+	fft_backend_free(ctx->analysis_frame);
+	fft_backend_free(ctx->analysis_data);
+	fft_backend_free(ctx->ring);
+	fft_backend_free(ctx->windowing_bank);
+	fft_backend_free(ctx->fft_in);
+	fft_backend_free(ctx->fft_out);
+	fft_backend_free(ctx->mag);
+	fft_backend_free(ctx->mag_sum);
+	fft_backend_free(ctx->channel_out);
+	fft_backend_free(ctx->channel_mag);
+	fft_backend_free(ctx->channel_mag_sum);
+	free(ctx->channel_stats);
+	free(ctx->channel_ptrs);
+	fft_decimator_free(ctx->decimator);
+	fft_backend_free(ctx->lowres_frame);
+	fft_backend_free(ctx->lowres_dec);
+	fft_backend_free(ctx->lowres_ring);
+	fft_backend_free(ctx->lowres_in);
+	fft_backend_free(ctx->lowres_out);
+	fft_backend_free(ctx->lowres_mag);
+	fft_backend_free(ctx->lowres_mag_sum);
+	free(ctx->onset_edges);
+	free(ctx->onset_prev);
+	free(ctx->tracked_bins);
+	free(ctx->goertzel_coeffs);
+	free(ctx->tracked_coeffs);
+	free(ctx->tracked_state);
+	free(ctx->tracked_mask);
+	free(ctx);
+}
+
+
+//------------------------------------------------------------------------------
+// FFT_AUDIO SINGLE-STREAM FUNCTIONS
+//
+// The following functions operate on one context owned by this library.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//
+// This function initialize all data required to perform the FFT and to extract
+// statistics from an audio file, using the default configuration.
+//
+//------------------------------------------------------------------------------
+int fft_audio_init(const char filename[],
+				   const size_t duration)
+{
+	fft_audio_config config;
+
+	config = fft_audio_config_default();
+	return fft_audio_init_with(filename, duration, &config);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function initialize all data required to perform the FFT and to extract
+// statistics from an audio file, using the provided configuration.
+//
+//------------------------------------------------------------------------------
+int fft_audio_init_with(const char filename[],
+						const size_t duration,
+						const fft_audio_config * config)
+{
+	fft_audio_free();
+	return fft_audio_ctx_init(&audio, filename, duration, config);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the samplerate of the provided audio file.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_get_samplerate()
+{
+	return fft_audio_ctx_get_samplerate(audio);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the number of channels of the provided audio file.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_get_channels()
+{
+	return fft_audio_ctx_get_channels(audio);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the samplerate of the values analysed by the FFT.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_get_analysis_samplerate()
+{
+	return fft_audio_ctx_get_analysis_samplerate(audio);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the number of samples in a frame.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_get_frame_samples()
+{
+	return fft_audio_ctx_get_frame_samples(audio);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the number of samples analysed by the FFT.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_get_window_samples()
+{
+	return fft_audio_ctx_get_window_samples(audio);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the length of the FFT.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_get_fft_samples()
+{
+	return fft_audio_ctx_get_fft_samples(audio);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the number of non-redundant samples of the spectrum.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_get_spectrum_samples()
+{
+	return fft_audio_ctx_get_spectrum_samples(audio);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function loads the next frame values from the provided audio file.
+//
+//------------------------------------------------------------------------------
+int fft_audio_load_next_frame()
+{
+	return fft_audio_ctx_load_next_frame(audio);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function loads the next frame values straight into the provided buffer.
+//
+//------------------------------------------------------------------------------
+int fft_audio_load_next_frame_into(float * buffer)
+{
+	return fft_audio_ctx_load_next_frame_into(audio, buffer);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function declares the "n" ranges whose statistics will be requested.
+//
+//------------------------------------------------------------------------------
+void fft_audio_set_bands(const fft_audio_range ranges[],
+						 const size_t n)
+{
+	fft_audio_ctx_set_bands(audio, ranges, n);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the engine that computes the spectrum.
+//
+//------------------------------------------------------------------------------
+fft_audio_engine fft_audio_get_engine()
+{
+	return fft_audio_ctx_get_engine(audio);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function computes the FFT of the current frame values applying the
+// windowing method provided.
+//
+//------------------------------------------------------------------------------
+void fft_audio_compute_fft(fft_audio_windowing windowing)
+{
+	fft_audio_ctx_compute_fft(audio, windowing);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function fill the provided "buffer" with current frame audio values.
+//
+//------------------------------------------------------------------------------
+void fft_audio_fill_buffer_data(float * buffer)
+{
+	fft_audio_ctx_fill_buffer_data(audio, buffer);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the statistics of the current FFT audio frame.
+//
+//------------------------------------------------------------------------------
+fft_audio_stats fft_audio_get_stats()
+{
+	return fft_audio_ctx_get_stats(audio);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the statistics of the FFT audio in the range of samples
+// [from, to].
+//
+//------------------------------------------------------------------------------
+fft_audio_stats fft_audio_get_stats_samples(const fft_audio_range range)
+{
+	return fft_audio_ctx_get_stats_samples(audio, range);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function fills "stats" with the statistics of the FFT audio in each of
+// the "n" provided ranges.
+//
+//------------------------------------------------------------------------------
+void fft_audio_get_band_stats(const fft_audio_range ranges[],
+							  const size_t n,
+							  fft_audio_stats stats[])
+{
+	fft_audio_ctx_get_band_stats(audio, ranges, n, stats);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function creates the perceptual bands of the spectra of the audio file.
+//
+//------------------------------------------------------------------------------
+int fft_audio_filterbank_init(fft_audio_filterbank ** afb,
+							  const fft_filterbank_scale scale,
+							  const size_t bands,
+							  const float min_freq,
+							  const float max_freq)
+{
+	return fft_audio_ctx_filterbank_init(audio, afb, scale, bands,
+										 min_freq, max_freq);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function fills "values" with the value of each band in the current
+// frame.
+//
+//------------------------------------------------------------------------------
+void fft_audio_get_filterbank_values(const fft_audio_filterbank * afb,
+									 float values[])
+{
+	fft_audio_ctx_get_filterbank_values(audio, afb, values);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the magnitudes of the spectrum of the current frame.
+//
+//------------------------------------------------------------------------------
+const float * fft_audio_get_magnitudes()
+{
+	return fft_audio_ctx_get_magnitudes(audio);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the onset detection of the current frame.
+//
+//------------------------------------------------------------------------------
+fft_audio_onset fft_audio_get_onset()
+{
+	return fft_audio_ctx_get_onset(audio);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the statistics of the current FFT audio frame values of
+// one channel.
+//
+//------------------------------------------------------------------------------
+fft_audio_stats fft_audio_get_channel_stats(const size_t channel)
+{
+	return fft_audio_ctx_get_channel_stats(audio, channel);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function fills "stats" with the statistics of one channel in each of the
+// "n" provided ranges.
+//
+//------------------------------------------------------------------------------
+void fft_audio_get_channel_band_stats(const size_t channel,
+									  const fft_audio_range ranges[],
+									  const size_t n,
+									  fft_audio_stats stats[])
+{
+	fft_audio_ctx_get_channel_band_stats(audio, channel, ranges, n, stats);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function frees all data and data structures used.
+//
+//------------------------------------------------------------------------------
+void fft_audio_free()
+{
+	fft_audio_ctx_free(audio);
+	audio = NULL;
 }
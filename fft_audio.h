@@ -5,12 +5,19 @@
 // LIBRARY TO SIMPLIFY THE LOADING OF AN AUDIO FILE AND THE COMPUTATION OF THE
 // FAST FOURIER TRANSFORM ON IT IN A WINDOWED FASHION.
 //
+// Each audio stream is analysed by its own "fft_audio_ctx" context, so several
+// independent streams can be analysed in parallel, one context per thread.
+// Functions taking a context are thread UNSAFE on the same context.
+// The fft_audio_* functions without a context operate on a single context
+// owned by this library.
+//
 //------------------------------------------------------------------------------
 #ifndef FFT_AUDIO_H
 #define FFT_AUDIO_H
 
 
 #include <stdlib.h>
+#include "fft_filterbank.h"
 
 
 //------------------------------------------------------------------------------
@@ -21,6 +28,9 @@
 #define FFT_AUDIO_ERROR_SAMPLERATE		2
 #define FFT_AUDIO_ERROR_CHANNELS		3
 #define FFT_AUDIO_EOF					4
+#define FFT_AUDIO_ERROR_MEMORY			5
+#define FFT_AUDIO_ERROR_BACKEND			6
+#define FFT_AUDIO_UNDERRUN				7
 
 
 //------------------------------------------------------------------------------
@@ -36,6 +46,34 @@ typedef enum {
 	fft_audio_blackman
 } fft_audio_windowing;
 
+typedef enum {
+	fft_audio_sizing_exact = 0,		// FFT length equal to the window
+	fft_audio_sizing_pad,			// window zero-padded to a fast FFT length
+	fft_audio_sizing_round			// window rounded up to a fast FFT length
+} fft_audio_sizing;
+
+typedef enum {
+	fft_audio_estimate = 0,
+	fft_audio_measure,
+	fft_audio_patient
+} fft_audio_planner;
+
+typedef enum {
+	fft_audio_analysis_mono = 0,	// one spectrum of the downmixed channels
+	fft_audio_analysis_channels		// also one spectrum for each channel
+} fft_audio_analysis;
+
+typedef enum {
+	fft_audio_engine_auto = 0,		// the cheapest for the declared bands
+	fft_audio_engine_fft,			// always the FFT of the whole spectrum
+	fft_audio_engine_goertzel		// Goertzel on the declared bands if any
+} fft_audio_engine;
+
+typedef enum {
+	fft_audio_backend_fftw = 0,		// FFTW, any FFT length
+	fft_audio_backend_builtin		// built-in FFT, power of two lengths
+} fft_audio_backend;
+
 
 //------------------------------------------------------------------------------
 // FFT_AUDIO GLOBAL STRUCTURES DECLARATION
@@ -51,6 +89,660 @@ typedef struct {
 	float magMax;
 } fft_audio_stats;
 
+typedef struct {
+	float flux;						// spectral flux of the current frame
+	float threshold;				// adaptive threshold of the flux
+	int onset;						// whether the current frame is an onset
+} fft_audio_onset;
+
+typedef struct {
+	fft_audio_planner planner;		// effort spent by FFTW to plan the FFT
+	const char * wisdom_filename;	// FFTW wisdom file, NULL to disable it
+	size_t hop_samples;				// frame samples, 0 to derive it from duration
+	size_t window_samples;			// samples analysed, 0 to analyse one frame
+	fft_audio_sizing sizing;		// how the FFT length is chosen
+	fft_audio_analysis analysis;	// whether channels are analysed one by one
+	size_t lowres_factor;			// decimation of the bass FFT, 0 to disable
+	fft_audio_engine engine;		// how the spectrum of the downmix is computed
+	size_t analysis_bandwidth;		// highest frequency analysed in Hz, 0 for
+									// the whole band of the audio file
+	size_t onset_bands;				// bands of the onset detection, 0 to
+									// disable it
+	fft_audio_backend backend;		// library computing the FFT
+	size_t threads;					// FFTW threads of long FFTs, 0 or 1 to
+									// use the calling thread only
+	size_t threads_min_samples;		// shortest FFT using "threads"
+	size_t lookahead_frames;		// frames decoded ahead by a reader thread,
+									// 0 to decode each frame when loaded
+	int preload;					// whether the whole file is decoded into
+									// locked memory by the initialization
+} fft_audio_config;
+
+// Opaque context of the analysis of an audio stream
+typedef struct fft_audio_ctx fft_audio_ctx;
+
+// Opaque perceptual bands of the spectra of a context
+typedef struct fft_audio_filterbank fft_audio_filterbank;
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the default configuration used by fft_audio_init().
+// The FFT is planned with fft_audio_estimate, no wisdom file is used and each
+// FFT analyses exactly one frame, whose duration is given at initialization,
+// without changing its length. Only the downmixed channels are analysed, at a
+// single resolution, by the cheapest engine for the declared bands, over the
+// whole band of the audio file, without onset detection, using FFTW on the
+// calling thread only. FFTs of 65536 samples and more would use "threads".
+// Each frame is decoded when it is loaded.
+//
+// RETURN
+// The default configuration.
+//
+//------------------------------------------------------------------------------
+fft_audio_config fft_audio_config_default();
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the string name of the provided windowing.
+//
+// PARAMETERS
+// windowing: the windowing enum value whose name you want to know
+//
+// RETURN
+// The string name of the provided windowing
+//
+//------------------------------------------------------------------------------
+char * fft_audio_get_windowing_name(fft_audio_windowing windowing);
+
+
+//------------------------------------------------------------------------------
+// FFT_AUDIO CONTEXT FUNCTIONS
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function creates a new context and initializes all data required to
+// perform the FFT and to extract statistics from an audio file in a sliding
+// frame fashion.
+// Uncompressed PCM WAV files are memory-mapped and converted straight from the
+// mapping, see fft_wav.h, while any other format is decoded by libsndfile.
+// Each loaded frame advances the analysis by "hop_samples" samples (one frame),
+// while each FFT analyses the last "window_samples" samples. Windows longer
+// than a frame overlap, so that the analysis resolution is not bound to the
+// frame duration (e.g. a 2048 samples window every 256 samples).
+// Since windows like 882 samples (20 ms at 44.1 kHz) are slow to transform,
+// "sizing" allows to zero-pad the window, or to lengthen it, up to the next
+// length whose only prime factors are 2, 3 and 5 (e.g. 900 samples).
+// If a wisdom file is provided, it is loaded before planning the FFT and it is
+// saved right after, so that the planning effort is paid only once: the next
+// starts reuse the stored plan without any extra startup time. A missing or
+// unwritable wisdom file is not an error.
+// With fft_audio_analysis_channels, each channel is transformed on its own by a
+// single batched FFT, and the spectrum of the downmix is obtained summing the
+// spectra of the channels, since the FFT is linear.
+// If "lowres_factor" is greater than 1, the downmix is also decimated by that
+// factor and transformed by a second FFT of the same length, which covers a
+// "lowres_factor" times longer time span with "lowres_factor" times finer bins.
+// The statistics of the downmix in ranges below the aliasing limit of the
+// decimation (FFT_DECIMATOR_PASSBAND of the decimated band) are then read from
+// this bass spectrum, while the others are read from the full-band one: bass
+// bands gain frequency resolution and treble bands keep time resolution.
+// Ranges are always expressed in bins of the full-band spectrum.
+// The spectrum of the downmix is computed by the FFT unless "engine" allows
+// the Goertzel algorithm, see fft_audio_ctx_set_bands().
+// If "analysis_bandwidth" is not 0, the analysed values are decimated by the
+// largest integer factor that divides the samplerate and keeps the bandwidth
+// below the aliasing limit of the decimation (FFT_DECIMATOR_PASSBAND of the
+// decimated band), e.g. 96 kHz audio is analysed at 48 kHz for a 16 kHz
+// bandwidth, while 44.1 kHz and 48 kHz audio are not decimated. The window,
+// the FFT and the ranges are then expressed in samples at the analysis
+// samplerate, while the frames and the buffer data stay at full samplerate.
+// If "onset_bands" is not 0, each FFT also updates the onset detection, see
+// fft_audio_ctx_get_onset(). It needs the whole spectrum, so it disables the
+// Goertzel engine.
+// The FFT is computed by the library selected by "backend". The built-in FFT
+// transforms power of two lengths only, and "sizing" lengthens the window to
+// the next power of two for it. If the selected backend is not part of the
+// build or cannot transform the FFT length, the other one is used.
+// FFTW splits each FFT among "threads" threads when its length is not lower
+// than "threads_min_samples", e.g. for offline analysis with 65536 to 1M
+// samples windows. Shorter FFTs, as the real-time ones, are computed on the
+// calling thread, since synchronizing the threads would cost more than the
+// transform itself.
+// If "lookahead_frames" is not 0, a reader thread decodes the next
+// "lookahead_frames" frames ahead of their load, so that loading a frame only
+// copies it from memory: disk or decoding stalls are absorbed by the frames
+// decoded ahead instead of delaying the caller. The frames are decoded before
+// this function returns, then the reader thread keeps decoding in background.
+// If "preload" is not 0, the whole file is decoded by this function into one
+// buffer, padded with silence to a whole number of frames, and the file is
+// closed: loading a frame only advances a pointer, with no I/O nor decoding
+// left for the caller, and no reader thread is created. The buffer is locked
+// in memory, so that it cannot be paged out; if locking is not allowed (e.g.
+// by RLIMIT_MEMLOCK), the buffer is used unlocked. The file is decoded until
+// its end, whatever length it declares. The whole file must fit in memory: it
+// suits short tracks played in a loop, not long ones.
+//
+// PARAMETERS
+// ctx: where the pointer to the new context is stored
+// filename: the path of the audio file
+// duration: frame duration size in milliseconds, used if "hop_samples" is 0
+// config: the configuration to be used
+//
+// RETURN
+// It returns:
+// - FFT_AUDIO_ERROR_MEMORY if the context cannot be allocated, the reader
+//   thread cannot be created, or the preloaded file does not fit in memory
+// - FFT_AUDIO_ERROR_FILE if the file does not exists or is not accessible.
+// - FFT_AUDIO_ERROR_SAMPLERATE if audio samplerate is too low to fill a frame
+//   of the given duration, or the frame or the window are too short
+// - FFT_AUDIO_ERROR_CHANNELS if the audio has no channels
+// - FFT_AUDIO_ERROR_BACKEND if no available backend can transform the FFT
+//   length, or the FFT cannot be planned
+// - FFT_AUDIO_SUCCESS otherwise
+// In case of error "ctx" is set to NULL.
+//
+//------------------------------------------------------------------------------
+int fft_audio_ctx_init(fft_audio_ctx ** ctx,
+					   const char filename[],
+					   const size_t duration,
+					   const fft_audio_config * config);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the samplerate of the audio file of the context.
+//
+// PARAMETERS
+// ctx: the context
+//
+// RETURN
+// The samplerate of the audio file of the context.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_ctx_get_samplerate(const fft_audio_ctx * ctx);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the number of channels of the audio file of the
+// context.
+//
+// PARAMETERS
+// ctx: the context
+//
+// RETURN
+// The number of channels of the audio file of the context.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_ctx_get_channels(const fft_audio_ctx * ctx);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the samplerate of the values analysed by the FFT of
+// the context, which is lower than the samplerate of the audio file if the
+// analysed band is limited.
+//
+// PARAMETERS
+// ctx: the context
+//
+// RETURN
+// The samplerate of the values analysed by the FFT of the context.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_ctx_get_analysis_samplerate(const fft_audio_ctx * ctx);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the number of samples in a frame of the context.
+//
+// PARAMETERS
+// ctx: the context
+//
+// RETURN
+// The number of samples in a frame of the context.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_ctx_get_frame_samples(const fft_audio_ctx * ctx);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the number of samples analysed by each FFT of the
+// context.
+//
+// PARAMETERS
+// ctx: the context
+//
+// RETURN
+// The number of samples in a window of the context.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_ctx_get_window_samples(const fft_audio_ctx * ctx);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the length of the FFT of the context. It is greater
+// than the number of samples in a window if the window is zero-padded.
+//
+// PARAMETERS
+// ctx: the context
+//
+// RETURN
+// The length of the FFT of the context.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_ctx_get_fft_samples(const fft_audio_ctx * ctx);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the number of samples of the spectrum computed by the
+// FFT of the context. Since the audio values are real, only the N / 2 + 1
+// non-redundant samples are computed, where N is the length of the FFT.
+//
+// PARAMETERS
+// ctx: the context
+//
+// RETURN
+// The number of samples of the spectrum of the context.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_ctx_get_spectrum_samples(const fft_audio_ctx * ctx);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function loads the next frame values from the audio file of the context.
+//
+// PARAMETERS
+// ctx: the context
+//
+// RETURN
+// If there is no data left, it returns FFT_AUDIO_EOF.
+// If the reader thread has not decoded the next frame yet, the frame is filled
+// with silence and it returns FFT_AUDIO_UNDERRUN: the next frame is only
+// delayed, not lost.
+// Otherwise it returns FFT_AUDIO_SUCCESS.
+//
+//------------------------------------------------------------------------------
+int fft_audio_ctx_load_next_frame(fft_audio_ctx * ctx);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function loads the next frame values from the audio file of the context,
+// decoding them straight into the provided buffer instead of the context data,
+// e.g. into the fragment of a playback stream. The buffer becomes the current
+// frame of the context: the analysis reads it in place, so the frame goes
+// through memory once for playback and analysis together. The buffer must stay
+// valid and unchanged until the FFT of the frame has been computed. At the end
+// of the file the buffer is filled with silence.
+//
+// PARAMETERS
+// ctx: the context
+// buffer: a float buffer of size (frame_samples * channels)
+//
+// RETURN
+// If there is no data left, it returns FFT_AUDIO_EOF.
+// If the reader thread has not decoded the next frame yet, the buffer is
+// filled with silence and it returns FFT_AUDIO_UNDERRUN.
+// Otherwise it returns FFT_AUDIO_SUCCESS.
+//
+//------------------------------------------------------------------------------
+int fft_audio_ctx_load_next_frame_into(fft_audio_ctx * ctx,
+									   float * buffer);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function declares the "n" ranges whose statistics will be requested
+// after each fft_audio_ctx_compute_fft(), until the next declaration.
+// If the context engine allows it, the bins of the declared ranges that are
+// not served by the bass spectrum are computed one by one with the Goertzel
+// algorithm instead of by the FFT. With fft_audio_engine_auto this happens
+// only when it is estimated to be cheaper than the FFT, i.e. when few narrow
+// ranges are declared.
+// While the Goertzel algorithm is in use, only the magnitudes of the declared
+// ranges are computed, the others are 0, and the statistics of the whole
+// spectrum are those of the declared bins. It is never used when channels
+// are analysed one by one.
+// The statistics of the declared ranges are the same whatever the engine, so
+// a scale that must not change when the engine switches (e.g. to normalize
+// the values of the ranges) is to be taken from them, see
+// fft_audio_ctx_get_band_stats(), not from fft_audio_ctx_get_stats().
+// Declaring no ranges restores the FFT.
+//
+// PARAMETERS
+// ctx: the context
+// ranges: the "n" ranges [from, to] that will be requested
+// n: the number of ranges
+//
+//------------------------------------------------------------------------------
+void fft_audio_ctx_set_bands(fft_audio_ctx * ctx,
+							 const fft_audio_range ranges[],
+							 const size_t n);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the engine that computes the spectrum of the downmix
+// of the context, selected by the last fft_audio_ctx_set_bands().
+//
+// PARAMETERS
+// ctx: the context
+//
+// RETURN
+// fft_audio_engine_goertzel if the Goertzel algorithm is in use.
+// Otherwise fft_audio_engine_fft.
+//
+//------------------------------------------------------------------------------
+fft_audio_engine fft_audio_ctx_get_engine(const fft_audio_ctx * ctx);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function computes the FFT of the current window values of the context
+// applying the windowing method provided.
+//
+// PARAMETERS
+// ctx: the context
+// windowing: the type of window to be applied
+//
+//------------------------------------------------------------------------------
+void fft_audio_ctx_compute_fft(fft_audio_ctx * ctx,
+							   fft_audio_windowing windowing);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function fills the provided "buffer" with current frame audio values of
+// the context. If the frame was loaded into "buffer" by
+// fft_audio_ctx_load_next_frame_into(), nothing is copied.
+//
+// PARAMETERS
+// ctx: the context
+// buffer: a float buffer of size (frame_samples * channels)
+//
+//------------------------------------------------------------------------------
+void fft_audio_ctx_fill_buffer_data(const fft_audio_ctx * ctx,
+									float * buffer);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the statistics of the current FFT audio frame values of
+// the context. They are calculated once per frame by fft_audio_ctx_compute_fft(),
+// so this function only reads them.
+//
+// PARAMETERS
+// ctx: the context
+//
+// RETURN
+// The statistics of the current FFT audio frame values. The statistics contains
+// the minimum, average and maximum magnitude of the FFT.
+//
+//------------------------------------------------------------------------------
+fft_audio_stats fft_audio_ctx_get_stats(const fft_audio_ctx * ctx);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the statistics of the FFT audio of the context in the
+// range of samples [from, to]. The average magnitude is obtained in O(1) from
+// prefix sums calculated once per frame.
+//
+// PARAMETERS
+// ctx: the context
+// range: the range [from, to] in which calculate the statistics. Both "from"
+//        and "to" must not be greater than the number of spectrum samples,
+//        and "from" must not be greater than "to"
+//
+// RETURN
+// The statistics of the FFT audio in the range of samples [from, to]. The
+// statistics of an empty range ("from" equal to "to") are all 0.
+//
+//------------------------------------------------------------------------------
+fft_audio_stats fft_audio_ctx_get_stats_samples(const fft_audio_ctx * ctx,
+												const fft_audio_range range);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function fills "stats" with the statistics of the FFT audio of the
+// context in each of the "n" provided ranges, like calling
+// fft_audio_ctx_get_stats_samples() on each range. The ranges are computed one
+// after the other, in any order: sorted and disjoint ones, as the bands of a
+// spectrum are, read each magnitude once. The statistics of an empty range
+// are all 0.
+//
+// PARAMETERS
+// ctx: the context
+// ranges: the "n" ranges [from, to] in which calculate the statistics
+// n: the number of ranges
+// stats: the array of "n" statistics to be filled
+//
+//------------------------------------------------------------------------------
+void fft_audio_ctx_get_band_stats(const fft_audio_ctx * ctx,
+								  const fft_audio_range ranges[],
+								  const size_t n,
+								  fft_audio_stats stats[]);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function creates the perceptual bands of the spectra of the context: a
+// filterbank of "bands" triangular filters, see fft_filterbank_init(), applied
+// to the full-band spectrum and, with the same edges, to the bass spectrum.
+// It is meant to be called once per number of bands, before the analysis,
+// since it allocates memory and uses transcendental math.
+//
+// PARAMETERS
+// ctx: the context
+// afb: where the pointer to the new bands is stored
+// scale: the frequency scale on which the filters are equally spaced
+// bands: the number of bands, greater than 0
+// min_freq: the lower edge of the first filter in Hz, greater than 0 for
+//           fft_filterbank_constant_q
+// max_freq: the upper edge of the last filter in Hz, greater than "min_freq"
+//           and not greater than half the analysis samplerate
+//
+// RETURN
+// If the bands cannot be allocated, this function returns
+// FFT_AUDIO_ERROR_MEMORY and "afb" is set to NULL.
+// Otherwise it returns FFT_AUDIO_SUCCESS.
+//
+//------------------------------------------------------------------------------
+int fft_audio_ctx_filterbank_init(const fft_audio_ctx * ctx,
+								  fft_audio_filterbank ** afb,
+								  const fft_filterbank_scale scale,
+								  const size_t bands,
+								  const float min_freq,
+								  const float max_freq);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the ranges of full-band samples covered by the bands,
+// one per band, sorted and never empty. They are the ranges to be declared
+// with fft_audio_ctx_set_bands() before requesting the values of the bands,
+// and their statistics are a scale for those values that does not change
+// with the engine.
+//
+// PARAMETERS
+// afb: the bands
+//
+// RETURN
+// The "bands" ranges [from, to] of the bands.
+//
+//------------------------------------------------------------------------------
+const fft_audio_range * fft_audio_filterbank_get_ranges(
+	const fft_audio_filterbank * afb);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function fills "values" with the value of each band in the current
+// frame of the context, the weighted average of the magnitudes it covers.
+// Like the statistics of ranges, a band whose range is entirely below the
+// bass limit is read from the finer bass spectrum, the others from the
+// full-band spectrum. The values are the same whatever the engine, as long
+// as the ranges of the bands, see fft_audio_filterbank_get_ranges(), are
+// the ones declared with fft_audio_ctx_set_bands().
+//
+// PARAMETERS
+// ctx: the context the bands were created for
+// afb: the bands
+// values: the array of "bands" values to be filled
+//
+//------------------------------------------------------------------------------
+void fft_audio_ctx_get_filterbank_values(const fft_audio_ctx * ctx,
+										 const fft_audio_filterbank * afb,
+										 float values[]);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function frees all data and data structures used by the bands.
+//
+// PARAMETERS
+// afb: the bands to be freed, it may be NULL
+//
+//------------------------------------------------------------------------------
+void fft_audio_filterbank_free(fft_audio_filterbank * afb);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the magnitudes of the full-band spectrum of the
+// downmix of the context, e.g. to be mapped by an fft_filterbank, see also
+// fft_audio_ctx_get_filterbank_values(). They are calculated once per frame by
+// fft_audio_ctx_compute_fft(), which overwrites them.
+//
+// PARAMETERS
+// ctx: the context
+//
+// RETURN
+// The fft_audio_ctx_get_spectrum_samples() magnitudes of the current frame.
+//
+//------------------------------------------------------------------------------
+const float * fft_audio_ctx_get_magnitudes(const fft_audio_ctx * ctx);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the onset detection of the current frame of the
+// context, which must be initialized with "onset_bands" greater than 0.
+// The spectrum of the downmix is split into "onset_bands" bands, equally
+// spaced on a logarithmic scale, and the spectral flux is the average increase
+// of their log-compressed amplitude A since the previous frame:
+// flux = sum of max(0, log(1 + g * A[b]) - log(1 + g * A_prev[b])) / bands
+// The frame is an onset if its flux exceeds an adaptive threshold, that follows
+// the recent mean and deviation of the flux, and no onset has been detected
+// in the last 100 ms. The first frame only seeds the energies of the bands,
+// so it is never an onset. Only onsets are reported: no tempo is tracked, so
+// onsets are not told apart from beats.
+// It is updated once per frame by fft_audio_ctx_compute_fft(), with O(bands)
+// state and operations and without any further FFT.
+//
+// PARAMETERS
+// ctx: the context
+//
+// RETURN
+// The spectral flux, its threshold and the onset flag of the current frame.
+//
+//------------------------------------------------------------------------------
+fft_audio_onset fft_audio_ctx_get_onset(const fft_audio_ctx * ctx);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the statistics of the current FFT audio frame values of
+// one channel of the context, like fft_audio_ctx_get_stats() does for the
+// downmixed channels. The context must be initialized with
+// fft_audio_analysis_channels.
+//
+// PARAMETERS
+// ctx: the context
+// channel: the channel, lower than the number of channels of the context
+//
+// RETURN
+// The statistics of the current FFT audio frame values of the channel.
+//
+//------------------------------------------------------------------------------
+fft_audio_stats fft_audio_ctx_get_channel_stats(const fft_audio_ctx * ctx,
+												const size_t channel);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function fills "stats" with the statistics of one channel of the context
+// in each of the "n" provided ranges, like fft_audio_ctx_get_band_stats() does
+// for the downmixed channels. The context must be initialized with
+// fft_audio_analysis_channels.
+//
+// PARAMETERS
+// ctx: the context
+// channel: the channel, lower than the number of channels of the context
+// ranges: the "n" ranges [from, to] in which calculate the statistics
+// n: the number of ranges
+// stats: the array of "n" statistics to be filled
+//
+//------------------------------------------------------------------------------
+void fft_audio_ctx_get_channel_band_stats(const fft_audio_ctx * ctx,
+										  const size_t channel,
+										  const fft_audio_range ranges[],
+										  const size_t n,
+										  fft_audio_stats stats[]);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function frees all data and data structures used by the context.
+//
+// PARAMETERS
+// ctx: the context to be freed, it may be NULL
+//
+//------------------------------------------------------------------------------
+void fft_audio_ctx_free(fft_audio_ctx * ctx);
+
+
+//------------------------------------------------------------------------------
+// FFT_AUDIO SINGLE-STREAM FUNCTIONS
+//------------------------------------------------------------------------------
 
 //------------------------------------------------------------------------------
 //
@@ -64,16 +756,38 @@ typedef struct {
 //
 // RETURN
 // It returns:
+// - FFT_AUDIO_ERROR_MEMORY if the data cannot be allocated
 // - FFT_AUDIO_ERROR_FILE if the file does not exists or is not accessible.
-// - FFT_AUDIO_ERROR_SAMPLERATE if audio samplerate is greater than the maximum
-//   samplerate manageable
-// - FFT_AUDIO_ERROR_CHANNELS if audio channels are more than 2
+// - FFT_AUDIO_ERROR_SAMPLERATE if audio samplerate is too low to fill a frame
+//   of the given duration
+// - FFT_AUDIO_ERROR_CHANNELS if the audio has no channels
 // - FFT_AUDIO_SUCCESS otherwise
 //
 //------------------------------------------------------------------------------
 int fft_audio_init(const char filename[],
 				   const size_t duration);
 
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function behaves like fft_audio_init() but it uses the provided
+// configuration, see fft_audio_ctx_init().
+//
+// PARAMETERS
+// filename: the path of the audio file
+// duration: frame duration size in milliseconds
+// config: the configuration to be used
+//
+// RETURN
+// The same values returned by fft_audio_init().
+//
+//------------------------------------------------------------------------------
+int fft_audio_init_with(const char filename[],
+						const size_t duration,
+						const fft_audio_config * config);
+
+
 //------------------------------------------------------------------------------
 //
 // DESCRIPTION
@@ -98,6 +812,18 @@ size_t fft_audio_get_samplerate();
 size_t fft_audio_get_channels();
 
 
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the samplerate of the values analysed by the FFT.
+//
+// RETURN
+// The samplerate of the values analysed by the FFT.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_get_analysis_samplerate();
+
+
 //------------------------------------------------------------------------------
 //
 // DESCRIPTION
@@ -113,16 +839,40 @@ size_t fft_audio_get_frame_samples();
 //------------------------------------------------------------------------------
 //
 // DESCRIPTION
-// This function returns the string name of the provided windowing.
+// This function returns the number of samples analysed by each FFT.
 //
-// PARAMETERS
-// windowing: the windowing enum value whose name you want to know
+// RETURN
+// The number of samples in a window.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_get_window_samples();
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the length of the FFT. It is greater than the number
+// of samples in a window if the window is zero-padded.
 //
 // RETURN
-// The string name of the provided windowing
+// The length of the FFT.
 //
 //------------------------------------------------------------------------------
-char * fft_audio_get_windowing_name(fft_audio_windowing windowing);
+size_t fft_audio_get_fft_samples();
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the number of samples of the spectrum computed by the
+// FFT. Since the audio values are real, only the N / 2 + 1 non-redundant
+// samples are computed, where N is the length of the FFT.
+//
+// RETURN
+// The number of samples of the spectrum.
+//
+//------------------------------------------------------------------------------
+size_t fft_audio_get_spectrum_samples();
 
 
 //------------------------------------------------------------------------------
@@ -132,12 +882,63 @@ char * fft_audio_get_windowing_name(fft_audio_windowing windowing);
 //
 // RETURN
 // If there is no data left, it returns FFT_AUDIO_EOF.
+// If the reader thread has not decoded the next frame yet, it returns
+// FFT_AUDIO_UNDERRUN, see fft_audio_ctx_load_next_frame().
 // Otherwise it returns FFT_AUDIO_SUCCESS.
 //
 //------------------------------------------------------------------------------
 int fft_audio_load_next_frame();
 
 
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function loads the next frame values straight into the provided buffer,
+// which the analysis then reads in place, see
+// fft_audio_ctx_load_next_frame_into().
+//
+// PARAMETERS
+// buffer: a float buffer of size (frame_samples * channels)
+//
+// RETURN
+// If there is no data left, it returns FFT_AUDIO_EOF.
+// If the reader thread has not decoded the next frame yet, it returns
+// FFT_AUDIO_UNDERRUN, see fft_audio_ctx_load_next_frame().
+// Otherwise it returns FFT_AUDIO_SUCCESS.
+//
+//------------------------------------------------------------------------------
+int fft_audio_load_next_frame_into(float * buffer);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function declares the "n" ranges whose statistics will be requested
+// after each fft_audio_compute_fft(), see fft_audio_ctx_set_bands().
+//
+// PARAMETERS
+// ranges: the "n" ranges [from, to] that will be requested
+// n: the number of ranges
+//
+//------------------------------------------------------------------------------
+void fft_audio_set_bands(const fft_audio_range ranges[],
+						 const size_t n);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the engine that computes the spectrum, see
+// fft_audio_ctx_get_engine().
+//
+// RETURN
+// fft_audio_engine_goertzel if the Goertzel algorithm is in use.
+// Otherwise fft_audio_engine_fft.
+//
+//------------------------------------------------------------------------------
+fft_audio_engine fft_audio_get_engine();
+
+
 //------------------------------------------------------------------------------
 //
 // DESCRIPTION
@@ -184,15 +985,137 @@ fft_audio_stats fft_audio_get_stats();
 // [from, to].
 //
 // PARAMETERS
-// range: the range [from, to] in which calculate the statistics
+// range: the range [from, to] in which calculate the statistics. Both "from"
+//        and "to" must not be greater than fft_audio_get_spectrum_samples(),
+//        and "from" must not be greater than "to"
 //
 // RETURN
-// The statistics of the FFT audio in the range of samples [from, to]
+// The statistics of the FFT audio in the range of samples [from, to], all 0
+// for an empty range, see fft_audio_ctx_get_stats_samples().
 //
 //------------------------------------------------------------------------------
 fft_audio_stats fft_audio_get_stats_samples(const fft_audio_range range);
 
 
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function fills "stats" with the statistics of the FFT audio in each of
+// the "n" provided ranges, see fft_audio_ctx_get_band_stats().
+//
+// PARAMETERS
+// ranges: the "n" ranges [from, to] in which calculate the statistics
+// n: the number of ranges
+// stats: the array of "n" statistics to be filled
+//
+//------------------------------------------------------------------------------
+void fft_audio_get_band_stats(const fft_audio_range ranges[],
+							  const size_t n,
+							  fft_audio_stats stats[]);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function creates the perceptual bands of the spectra of the audio file,
+// see fft_audio_ctx_filterbank_init(). They are freed with
+// fft_audio_filterbank_free().
+//
+// PARAMETERS
+// afb: where the pointer to the new bands is stored
+// scale: the frequency scale on which the filters are equally spaced
+// bands: the number of bands, greater than 0
+// min_freq: the lower edge of the first filter in Hz
+// max_freq: the upper edge of the last filter in Hz
+//
+// RETURN
+// If the bands cannot be allocated, this function returns
+// FFT_AUDIO_ERROR_MEMORY. Otherwise it returns FFT_AUDIO_SUCCESS.
+//
+//------------------------------------------------------------------------------
+int fft_audio_filterbank_init(fft_audio_filterbank ** afb,
+							  const fft_filterbank_scale scale,
+							  const size_t bands,
+							  const float min_freq,
+							  const float max_freq);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function fills "values" with the value of each band in the current
+// frame, see fft_audio_ctx_get_filterbank_values().
+//
+// PARAMETERS
+// afb: the bands
+// values: the array of "bands" values to be filled
+//
+//------------------------------------------------------------------------------
+void fft_audio_get_filterbank_values(const fft_audio_filterbank * afb,
+									 float values[]);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the magnitudes of the spectrum of the current frame,
+// see fft_audio_ctx_get_magnitudes().
+//
+// RETURN
+// The fft_audio_get_spectrum_samples() magnitudes of the current frame.
+//
+//------------------------------------------------------------------------------
+const float * fft_audio_get_magnitudes();
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the onset detection of the current frame, see
+// fft_audio_ctx_get_onset().
+//
+// RETURN
+// The spectral flux, its threshold and the onset flag of the current frame.
+//
+//------------------------------------------------------------------------------
+fft_audio_onset fft_audio_get_onset();
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the statistics of the current FFT audio frame values of
+// one channel, see fft_audio_ctx_get_channel_stats().
+//
+// PARAMETERS
+// channel: the channel, lower than fft_audio_get_channels()
+//
+// RETURN
+// The statistics of the current FFT audio frame values of the channel.
+//
+//------------------------------------------------------------------------------
+fft_audio_stats fft_audio_get_channel_stats(const size_t channel);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function fills "stats" with the statistics of one channel in each of the
+// "n" provided ranges, see fft_audio_ctx_get_channel_band_stats().
+//
+// PARAMETERS
+// channel: the channel, lower than fft_audio_get_channels()
+// ranges: the "n" ranges [from, to] in which calculate the statistics
+// n: the number of ranges
+// stats: the array of "n" statistics to be filled
+//
+//------------------------------------------------------------------------------
+void fft_audio_get_channel_band_stats(const size_t channel,
+									  const fft_audio_range ranges[],
+									  const size_t n,
+									  fft_audio_stats stats[]);
+
+
 //------------------------------------------------------------------------------
 //
 // DESCRIPTION
@@ -0,0 +1,339 @@
+#include "fft_backend.h"
+#include "fft_radix.h"
+#include <assert.h>
+
+#if !defined(FFT_BACKEND_NO_FFTW)
+	#include <fftw3.h>
+#endif
+
+
+//------------------------------------------------------------------------------
+// FFT_BACKEND LOCAL STRUCT DEFINITIONS
+//------------------------------------------------------------------------------
+struct fft_backend_plan {
+	fft_backend_type type;						// Backend of the plan
+#if !defined(FFT_BACKEND_NO_FFTW)
+	fftwf_plan fftw;							// FFTW plan
+#endif
+	fft_radix * radix;							// Built-in FFT
+	float * in;									// Real values
+	fft_backend_complex * out;					// Complex values
+	size_t howmany;								// Num. of signals
+	size_t in_dist;								// Dist. of the signals
+	size_t out_dist;							// Dist. of the spectra
+};
+
+
+//------------------------------------------------------------------------------
+// FFT_BACKEND LOCAL DATA
+//------------------------------------------------------------------------------
+static const char * backend_names[] = {
+	"FFTW",
+	"Built-in"
+};
+
+#if !defined(FFT_BACKEND_NO_FFTW)
+// Whether the FFTW threads have been initialized: 0 not yet, 1 successfully,
+// -1 unsuccessfully. It is only accessed while planning, which is serialized
+static int fftw_threads_state = 0;
+#endif
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the string name of the provided backend.
+//
+//------------------------------------------------------------------------------
+const char * fft_backend_get_name(const fft_backend_type type)
+{
+	return backend_names[type];
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns whether the provided backend is part of this build.
+//
+//------------------------------------------------------------------------------
+int fft_backend_is_available(const fft_backend_type type)
+{
+#if defined(FFT_BACKEND_NO_FFTW)
+	return type == fft_backend_builtin;
+#else
+	return 1;
+#endif
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns whether the provided backend can transform "n" real
+// values.
+//
+//------------------------------------------------------------------------------
+int fft_backend_supports(const fft_backend_type type,
+						 const size_t n)
+{
+	if (!fft_backend_is_available(type) || n == 0) {
+		return 0;
+	}
+
+	return type != fft_backend_builtin || fft_radix_supports(n);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the smallest fast length of the backend not lower than
+// "n". FFTW computes lengths whose only prime factors are 2, 3 and 5 much
+// faster than lengths with larger prime factors.
+//
+//------------------------------------------------------------------------------
+size_t fft_backend_fast_size(const fft_backend_type type,
+							 const size_t n)
+{
+	size_t size;
+	size_t m;
+
+	if (type == fft_backend_builtin) {
+		for (size = 2; size < n; size *= 2);
+		return size;
+	}
+
+	for (size = n; ; ++size) {
+		m = size;
+		while (m % 2 == 0) m /= 2;
+		while (m % 3 == 0) m /= 3;
+		while (m % 5 == 0) m /= 5;
+		if (m == 1) {
+			return size;
+		}
+	}
+}
+
+
+//------------------------------------------------------------------------------
+//
+// These functions allocate and free the aligned buffers of the plans.
+//
+//------------------------------------------------------------------------------
+void * fft_backend_malloc(const size_t bytes)
+{
+	void * ptr;
+
+	if (posix_memalign(&ptr, FFT_BACKEND_ALIGNMENT, bytes) != 0) {
+		return NULL;
+	}
+
+	return ptr;
+}
+
+float * fft_backend_alloc_real(const size_t n)
+{
+	return fft_backend_malloc(n * sizeof(float));
+}
+
+fft_backend_complex * fft_backend_alloc_complex(const size_t n)
+{
+	return fft_backend_malloc(n * sizeof(fft_backend_complex));
+}
+
+void fft_backend_free(void * ptr)
+{
+	free(ptr);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// These functions load and store the FFTW wisdom.
+//
+//------------------------------------------------------------------------------
+void fft_backend_import_wisdom(const char * filename)
+{
+	assert(filename != NULL);
+
+#if !defined(FFT_BACKEND_NO_FFTW)
+	fftwf_import_wisdom_from_filename(filename);
+#endif
+}
+
+void fft_backend_export_wisdom(const char * filename)
+{
+	assert(filename != NULL);
+
+#if !defined(FFT_BACKEND_NO_FFTW)
+	fftwf_export_wisdom_to_filename(filename);
+#endif
+}
+
+
+#if !defined(FFT_BACKEND_NO_FFTW)
+//------------------------------------------------------------------------------
+//
+// This function is a help function that sets the num. of threads used by the
+// next FFTW plans, initializing the FFTW threads the first time more than one
+// is requested. If they cannot be initialized, the plans stay single-threaded.
+//
+//------------------------------------------------------------------------------
+static void fft_backend_fftw_threads(const size_t threads)
+{
+	if (threads <= 1) {
+		if (fftw_threads_state > 0) {
+			fftwf_plan_with_nthreads(1);
+		}
+		return;
+	}
+
+	if (fftw_threads_state == 0) {
+		fftw_threads_state = fftwf_init_threads() ? 1 : -1;
+	}
+
+	if (fftw_threads_state > 0) {
+		fftwf_plan_with_nthreads(threads);
+	}
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function is a help function that returns the FFTW planner flags
+// corresponding to the provided planning effort.
+//
+//------------------------------------------------------------------------------
+static unsigned fft_backend_fftw_flags(const fft_backend_effort effort)
+{
+	switch (effort) {
+		case fft_backend_measure:
+			return FFTW_MEASURE;
+		case fft_backend_patient:
+			return FFTW_PATIENT;
+		case fft_backend_estimate:
+		default:
+			return FFTW_ESTIMATE;
+	}
+}
+#endif
+
+
+//------------------------------------------------------------------------------
+//
+// This function creates a plan that transforms "howmany" signals of "n" real
+// values each. FFTW transforms a single signal with a 1-d plan and more
+// signals with a single batched plan, sharing its setup; the built-in FFT
+// transforms them one after the other. The num. of FFTW threads is global to
+// the planner, so it is set right before planning.
+//
+//------------------------------------------------------------------------------
+int fft_backend_plan_init(fft_backend_plan ** plan_ptr,
+						  const fft_backend_type type,
+						  const size_t n,
+						  const size_t howmany,
+						  float * in,
+						  const size_t in_dist,
+						  fft_backend_complex * out,
+						  const size_t out_dist,
+						  const fft_backend_effort effort,
+						  const size_t threads)
+{
+	fft_backend_plan * plan;
+#if !defined(FFT_BACKEND_NO_FFTW)
+	int fft_len;
+#endif
+
+	assert(plan_ptr != NULL);
+	assert(fft_backend_supports(type, n));
+	assert(howmany > 0);
+	assert(in != NULL && out != NULL);
+
+	*plan_ptr = NULL;
+
+	plan = calloc(1, sizeof(fft_backend_plan));
+	if (plan == NULL) {
+		return FFT_BACKEND_ERROR;
+	}
+
+	plan->type = type;
+	plan->in = in;
+	plan->out = out;
+	plan->howmany = howmany;
+	plan->in_dist = in_dist;
+	plan->out_dist = out_dist;
+
+	if (type == fft_backend_builtin) {
+		if (fft_radix_init(&plan->radix, n) != FFT_RADIX_SUCCESS) {
+			fft_backend_plan_free(plan);
+			return FFT_BACKEND_ERROR;
+		}
+		*plan_ptr = plan;
+		return FFT_BACKEND_SUCCESS;
+	}
+
+#if !defined(FFT_BACKEND_NO_FFTW)
+	fft_backend_fftw_threads(threads);
+	if (howmany > 1) {
+		fft_len = n;
+		plan->fftw = fftwf_plan_many_dft_r2c(1, &fft_len, howmany,
+											 in, NULL, 1, in_dist,
+											 out, NULL, 1, out_dist,
+											 fft_backend_fftw_flags(effort));
+	} else {
+		plan->fftw = fftwf_plan_dft_r2c_1d(n, in, out,
+										   fft_backend_fftw_flags(effort));
+	}
+
+	if (plan->fftw == NULL) {
+		fft_backend_plan_free(plan);
+		return FFT_BACKEND_ERROR;
+	}
+#endif
+
+	*plan_ptr = plan;
+	return FFT_BACKEND_SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function transforms the current values of the buffers of the plan.
+//
+//------------------------------------------------------------------------------
+void fft_backend_execute(fft_backend_plan * plan)
+{
+	size_t i;
+
+	assert(plan != NULL);
+
+	if (plan->type == fft_backend_builtin) {
+		for (i = 0; i < plan->howmany; ++i) {
+			fft_radix_execute(plan->radix, plan->in + i * plan->in_dist,
+							  plan->out + i * plan->out_dist);
+		}
+		return;
+	}
+
+#if !defined(FFT_BACKEND_NO_FFTW)
+	fftwf_execute(plan->fftw);
+#endif
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function frees all data and data structures used by the plan.
+//
+//------------------------------------------------------------------------------
+void fft_backend_plan_free(fft_backend_plan * plan)
+{
+	if (plan == NULL) {
+		return;
+	}
+
+#if !defined(FFT_BACKEND_NO_FFTW)
+	if (plan->fftw != NULL) {
+		fftwf_destroy_plan(plan->fftw);
+	}
+#endif
+	fft_radix_free(plan->radix);
+	free(plan);
+}
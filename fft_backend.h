@@ -0,0 +1,223 @@
+//------------------------------------------------------------------------------
+//
+// FFT_BACKEND
+//
+// MODULE TO COMPUTE REAL FFTS WITH A CHOICE OF FFT LIBRARIES.
+//
+// This module hides the FFT library behind a small plan interface, so that the
+// audio analysis can be built and run on top of either of:
+// - FFTW, the default, which supports any length;
+// - the built-in split-radix FFT of fft_radix, which supports power of two
+//   lengths and needs no external library.
+// Building with FFT_BACKEND_NO_FFTW defined removes FFTW entirely, for a leaner
+// static build: the built-in FFT is then the only available backend.
+// The buffers transformed by a plan must be allocated by this module, so that
+// they are aligned for the SIMD codelets of every backend.
+// FFTW may split the execution of a plan among several threads, which pays off
+// only for long transforms (e.g. 65536 values and more).
+// Creating and freeing plans, and the wisdom functions, are thread UNSAFE and
+// must be serialized by the caller; executing different plans is thread safe.
+//
+//------------------------------------------------------------------------------
+#ifndef FFT_BACKEND_H
+#define FFT_BACKEND_H
+
+
+#include <stdlib.h>
+
+
+//------------------------------------------------------------------------------
+// FFT_BACKEND GLOBAL CONSTANTS
+//------------------------------------------------------------------------------
+#define FFT_BACKEND_SUCCESS			0
+#define FFT_BACKEND_ERROR			1
+
+#define FFT_BACKEND_ALIGNMENT		64		// Bytes, a cache line and an
+											// AVX-512 register
+
+
+//------------------------------------------------------------------------------
+// FFT_BACKEND GLOBAL ENUMS DECLARATION
+//------------------------------------------------------------------------------
+typedef enum {
+	fft_backend_fftw = 0,			// FFTW, any length
+	fft_backend_builtin				// built-in split-radix, powers of two
+} fft_backend_type;
+
+typedef enum {
+	fft_backend_estimate = 0,		// plan without measuring
+	fft_backend_measure,			// measure some algorithms
+	fft_backend_patient				// measure more algorithms
+} fft_backend_effort;
+
+
+//------------------------------------------------------------------------------
+// FFT_BACKEND GLOBAL STRUCTURES DECLARATION
+//------------------------------------------------------------------------------
+typedef float fft_backend_complex[2];	// real and imaginary part, as the
+										// fftwf_complex of FFTW
+
+typedef struct fft_backend_plan fft_backend_plan;
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the string name of the provided backend.
+//
+// PARAMETERS
+// type: the backend
+//
+// RETURN
+// The string name of the provided backend.
+//
+//------------------------------------------------------------------------------
+const char * fft_backend_get_name(const fft_backend_type type);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns whether the provided backend is part of this build.
+//
+// PARAMETERS
+// type: the backend
+//
+// RETURN
+// 1 if the backend is available, 0 otherwise.
+//
+//------------------------------------------------------------------------------
+int fft_backend_is_available(const fft_backend_type type);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns whether the provided backend is available and can
+// transform "n" real values.
+//
+// PARAMETERS
+// type: the backend
+// n: the number of real values to be transformed
+//
+// RETURN
+// 1 if the backend supports the length, 0 otherwise.
+//
+//------------------------------------------------------------------------------
+int fft_backend_supports(const fft_backend_type type,
+						 const size_t n);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the smallest length not lower than "n" that the
+// provided backend transforms fast: a length whose only prime factors are 2, 3
+// and 5 for FFTW, a power of two for the built-in FFT.
+//
+// PARAMETERS
+// type: the backend
+// n: the minimum length
+//
+// RETURN
+// The smallest fast length not lower than "n".
+//
+//------------------------------------------------------------------------------
+size_t fft_backend_fast_size(const fft_backend_type type,
+							 const size_t n);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// These functions allocate and free the buffers transformed by the plans,
+// aligned to FFT_BACKEND_ALIGNMENT bytes. The allocation functions return
+// NULL on failure, the free function accepts NULL.
+//
+//------------------------------------------------------------------------------
+void * fft_backend_malloc(const size_t bytes);
+float * fft_backend_alloc_real(const size_t n);
+fft_backend_complex * fft_backend_alloc_complex(const size_t n);
+void fft_backend_free(void * ptr);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// These functions load and store the FFTW wisdom, so that the planning effort
+// of FFTW is paid only once. A missing or unwritable file is ignored, and
+// without FFTW they do nothing.
+//
+// PARAMETERS
+// filename: the path of the wisdom file
+//
+//------------------------------------------------------------------------------
+void fft_backend_import_wisdom(const char * filename);
+void fft_backend_export_wisdom(const char * filename);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function creates a plan that transforms "howmany" signals of "n" real
+// values each, into their n / 2 + 1 non-redundant complex values. The signal
+// "j" is read from in + j * in_dist and its spectrum is stored at
+// out + j * out_dist. Planning with FFTW may overwrite "in" and "out".
+//
+// PARAMETERS
+// plan: where the pointer to the new plan is stored
+// type: the backend, which must support "n"
+// n: the number of real values of each signal
+// howmany: the number of signals
+// in: the buffer of the real values
+// in_dist: the distance between two signals in "in"
+// out: the buffer of the complex values
+// out_dist: the distance between two spectra in "out"
+// effort: the effort spent by FFTW to plan the transform
+// threads: the num. of threads FFTW may use to execute the plan, 0 or 1 to
+//          execute it on the calling thread only. The built-in FFT ignores it
+//
+// RETURN
+// If the plan cannot be created, this function returns FFT_BACKEND_ERROR and
+// "plan" is set to NULL.
+// Otherwise it returns FFT_BACKEND_SUCCESS.
+//
+//------------------------------------------------------------------------------
+int fft_backend_plan_init(fft_backend_plan ** plan,
+						  const fft_backend_type type,
+						  const size_t n,
+						  const size_t howmany,
+						  float * in,
+						  const size_t in_dist,
+						  fft_backend_complex * out,
+						  const size_t out_dist,
+						  const fft_backend_effort effort,
+						  const size_t threads);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function transforms the current values of the buffers of the plan.
+//
+// PARAMETERS
+// plan: the plan
+//
+//------------------------------------------------------------------------------
+void fft_backend_execute(fft_backend_plan * plan);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function frees all data and data structures used by the plan. Its
+// buffers are not freed.
+//
+// PARAMETERS
+// plan: the plan to be freed, it may be NULL
+//
+//------------------------------------------------------------------------------
+void fft_backend_plan_free(fft_backend_plan * plan);
+
+
+#endif
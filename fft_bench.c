@@ -0,0 +1,195 @@
+//------------------------------------------------------------------------------
+//
+// FFT_BENCH
+//
+// BENCHMARK OF THE FFT BACKENDS.
+//
+// This program times the real FFT of every available backend on the lengths
+// used by the audio analysis, and reports the time of a single transform and
+// the largest difference of the built-in spectrum from the FFTW one.
+// Run it with "make bench".
+//
+//------------------------------------------------------------------------------
+#include "fft_backend.h"
+#include "time_utils.h"
+#include <stdio.h>
+#include <math.h>
+
+
+//------------------------------------------------------------------------------
+// FFT_BENCH LOCAL CONSTANTS
+//------------------------------------------------------------------------------
+#define BENCH_VALUES		(1 << 24)	// Num. of values transformed per length
+#define BENCH_MIN_REPS		16			// Min. num. of transforms per length
+#define BENCH_BACKENDS		2			// Num. of backends
+
+// Lengths: the powers of two of the built-in FFT, and the 20 ms frames at
+// 44.1 kHz, raw (882) and lengthened to a fast FFTW length (900)
+static const size_t bench_sizes[] = {
+	256, 512, 882, 900, 1024, 2048, 4096, 8192
+};
+
+
+//------------------------------------------------------------------------------
+//
+// This function is a help function that transforms "in" with the provided
+// backend and stores the spectrum in "out". It returns the average time of a
+// single transform in nanoseconds, or a negative value if the backend does not
+// support the length.
+//
+//------------------------------------------------------------------------------
+static double bench_backend(const fft_backend_type type,
+							const size_t n,
+							const float * in,
+							fft_backend_complex * out)
+{
+	size_t i;
+	size_t reps;
+	float * buf_in;
+	fft_backend_complex * buf_out;
+	fft_backend_plan * plan;
+	struct timespec t1;
+	struct timespec t2;
+	struct timespec td;
+	double ns = -1.0;
+
+	if (!fft_backend_supports(type, n)) {
+		return ns;
+	}
+
+	buf_in = fft_backend_alloc_real(n);
+	buf_out = fft_backend_alloc_complex(n / 2 + 1);
+	if (buf_in == NULL || buf_out == NULL ||
+		fft_backend_plan_init(&plan, type, n, 1, buf_in, n, buf_out, n / 2 + 1,
+							  fft_backend_measure, 1) != FFT_BACKEND_SUCCESS) {
+		fft_backend_free(buf_in);
+		fft_backend_free(buf_out);
+		return ns;
+	}
+
+	// Planning may overwrite the buffers, so they are filled only afterwards
+	for (i = 0; i < n; ++i) {
+		buf_in[i] = in[i];
+	}
+	fft_backend_execute(plan);
+
+	reps = BENCH_VALUES / n;
+	if (reps < BENCH_MIN_REPS) {
+		reps = BENCH_MIN_REPS;
+	}
+
+	time_now(&t1);
+	for (i = 0; i < reps; ++i) {
+		fft_backend_execute(plan);
+	}
+	time_now(&t2);
+	time_diff(&td, t1, t2);
+	ns = (td.tv_sec * 1e9 + td.tv_nsec) / reps;
+
+	for (i = 0; i < n / 2 + 1; ++i) {
+		out[i][0] = buf_out[i][0];
+		out[i][1] = buf_out[i][1];
+	}
+
+	fft_backend_plan_free(plan);
+	fft_backend_free(buf_in);
+	fft_backend_free(buf_out);
+	return ns;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function is a help function that returns the largest difference between
+// the spectra "a" and "b" of "n" values, relative to the largest magnitude.
+//
+//------------------------------------------------------------------------------
+static double bench_max_error(fft_backend_complex * a,
+							  fft_backend_complex * b,
+							  const size_t n)
+{
+	size_t i;
+	double err = 0.0;
+	double mag = 0.0;
+
+	for (i = 0; i < n; ++i) {
+		err = fmax(err, hypot(a[i][0] - b[i][0], a[i][1] - b[i][1]));
+		mag = fmax(mag, hypot(a[i][0], a[i][1]));
+	}
+
+	return (mag > 0.0) ? err / mag : err;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function is a help function that prints the time of a backend, or a
+// dash if the backend does not support the length.
+//
+//------------------------------------------------------------------------------
+static void bench_print_time(const double ns)
+{
+	if (ns < 0.0) {
+		printf(" %12s", "-");
+	} else {
+		printf(" %12.0f", ns);
+	}
+}
+
+
+int main()
+{
+	size_t i;
+	size_t j;
+	size_t n;
+	size_t max_n = 0;
+	float * in;
+	fft_backend_complex * out[BENCH_BACKENDS];
+	double ns[BENCH_BACKENDS];
+	const size_t sizes = sizeof(bench_sizes) / sizeof(bench_sizes[0]);
+
+	for (i = 0; i < sizes; ++i) {
+		if (bench_sizes[i] > max_n) {
+			max_n = bench_sizes[i];
+		}
+	}
+
+	in = fft_backend_alloc_real(max_n);
+	out[fft_backend_fftw] = fft_backend_alloc_complex(max_n / 2 + 1);
+	out[fft_backend_builtin] = fft_backend_alloc_complex(max_n / 2 + 1);
+	if (in == NULL || out[fft_backend_fftw] == NULL ||
+		out[fft_backend_builtin] == NULL) {
+		fprintf(stderr, "FFT_BENCH ERROR - Cannot allocate the buffers\n");
+		return 1;
+	}
+
+	// A noisy chord, as the audio frames
+	srand(1);
+	for (i = 0; i < max_n; ++i) {
+		in[i] = 0.5f * sinf(0.031f * i) + 0.25f * sinf(0.173f * i) +
+				0.1f * ((float)rand() / RAND_MAX - 0.5f);
+	}
+
+	printf("%6s %12s %12s %12s\n", "n", "FFTW ns", "Built-in ns", "max error");
+	for (i = 0; i < sizes; ++i) {
+		n = bench_sizes[i];
+		for (j = 0; j < BENCH_BACKENDS; ++j) {
+			ns[j] = bench_backend(j, n, in, out[j]);
+		}
+
+		printf("%6zu", n);
+		bench_print_time(ns[fft_backend_fftw]);
+		bench_print_time(ns[fft_backend_builtin]);
+		if (ns[fft_backend_fftw] >= 0.0 && ns[fft_backend_builtin] >= 0.0) {
+			printf(" %12.2e", bench_max_error(out[fft_backend_fftw],
+											  out[fft_backend_builtin],
+											  n / 2 + 1));
+		}
+		printf("\n");
+	}
+
+	fft_backend_free(in);
+	fft_backend_free(out[fft_backend_fftw]);
+	fft_backend_free(out[fft_backend_builtin]);
+	return 0;
+}
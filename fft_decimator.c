@@ -0,0 +1,189 @@
+#include "fft_decimator.h"
+#include "fft_kernels.h"
+#include <math.h>
+#include <assert.h>
+
+
+//------------------------------------------------------------------------------
+// FFT_DECIMATOR LOCAL CONSTANTS
+//------------------------------------------------------------------------------
+// Num. of taps per unit of factor. The transition band of the filter is
+// 2 * (1 - FFT_DECIMATOR_PASSBAND) / (2 * factor) wide, and a Blackman windowed
+// sinc needs about 5.5 taps over the width of its transition band
+#define TAPS_PER_FACTOR		28
+
+
+//------------------------------------------------------------------------------
+// FFT_DECIMATOR LOCAL STRUCT DEFINITIONS
+//------------------------------------------------------------------------------
+struct fft_decimator {
+	float * coeffs;								// Coefficients of the filter
+	float * history;							// Last inputs of each channel,
+												// stored twice
+	size_t taps;								// Num. of coefficients
+	size_t factor;								// Decimation factor
+	size_t channels;							// Num. of channels
+	size_t pos;									// Oldest elem of the history
+	size_t phase;								// Inputs since last output
+};
+
+
+//------------------------------------------------------------------------------
+//
+// This function is a help function that calculates the coefficients of the
+// low-pass filter: a sinc cut at half the output band, windowed by a Blackman
+// window and normalized to unity gain. Each coefficient is calculated as
+// follows:
+// fc = 1 / (2 * factor)
+// h[i] = 2 * fc * sinc(2 * fc * (i - (N - 1) / 2)) * blackman[i]
+//
+//------------------------------------------------------------------------------
+static void fft_decimator_fill_coeffs(fft_decimator * dec)
+{
+	size_t i;
+	double t;
+	double sum = 0.0;
+	const size_t N = dec->taps;
+	const double fc = 0.5 / dec->factor;
+
+	for (i = 0; i < N; ++i) {
+		t = i - (N - 1) / 2.0;
+		dec->coeffs[i] = 2.0 * fc;
+		if (t != 0.0) {
+			dec->coeffs[i] = sin(2.0 * M_PI * fc * t) / (M_PI * t);
+		}
+		dec->coeffs[i] *= 0.42 - 0.5 * cos(2.0 * M_PI * i / (N - 1)) +
+						  0.08 * cos(4.0 * M_PI * i / (N - 1));
+		sum += dec->coeffs[i];
+	}
+
+	for (i = 0; i < N; ++i) {
+		dec->coeffs[i] /= sum;
+	}
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function creates a new decimator by "factor" of "channels" interleaved
+// channels.
+//
+//------------------------------------------------------------------------------
+int fft_decimator_init(fft_decimator ** dec_ptr,
+					   const size_t factor,
+					   const size_t channels)
+{
+	size_t i;
+	fft_decimator * dec;
+
+	assert(dec_ptr != NULL);
+	assert(factor > 1);
+	assert(channels > 0);
+
+	*dec_ptr = NULL;
+
+	dec = calloc(1, sizeof(fft_decimator));
+	if (dec == NULL) {
+		return FFT_DECIMATOR_ERROR;
+	}
+
+	dec->factor = factor;
+	dec->channels = channels;
+	dec->taps = TAPS_PER_FACTOR * factor + 1;
+	dec->pos = 0;
+	dec->phase = 0;
+
+	// The history of each channel is stored twice, so that its last "taps"
+	// inputs are always contiguous starting from the oldest one
+	dec->coeffs = malloc(dec->taps * sizeof(float));
+	dec->history = malloc(2 * dec->taps * channels * sizeof(float));
+
+	if (dec->coeffs == NULL || dec->history == NULL) {
+		fft_decimator_free(dec);
+		return FFT_DECIMATOR_ERROR;
+	}
+
+	for (i = 0; i < 2 * dec->taps * channels; ++i) {
+		dec->history[i] = 0.0f;
+	}
+	fft_decimator_fill_coeffs(dec);
+
+	*dec_ptr = dec;
+	return FFT_DECIMATOR_SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the decimation factor of the decimator.
+//
+//------------------------------------------------------------------------------
+size_t fft_decimator_get_factor(const fft_decimator * dec)
+{
+	assert(dec != NULL);
+
+	return dec->factor;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function filters "n" input samples of each channel and stores the
+// decimated ones in "dst". Only one input out of "factor" is filtered.
+//
+//------------------------------------------------------------------------------
+size_t fft_decimator_process(fft_decimator * dec,
+							 float * dst,
+							 const float * src,
+							 const size_t n)
+{
+	size_t i;
+	size_t j;
+	size_t count = 0;
+	float * history;
+	const size_t channels = dec->channels;
+
+	assert(dec != NULL);
+	assert(n == 0 || (dst != NULL && src != NULL));
+
+	for (i = 0; i < n; ++i) {
+		for (j = 0; j < channels; ++j) {
+			history = dec->history + 2 * dec->taps * j;
+			history[dec->pos] = src[i * channels + j];
+			history[dec->pos + dec->taps] = src[i * channels + j];
+		}
+		dec->pos = (dec->pos + 1) % dec->taps;
+
+		if (++dec->phase < dec->factor) {
+			continue;
+		}
+
+		dec->phase = 0;
+		for (j = 0; j < channels; ++j) {
+			history = dec->history + 2 * dec->taps * j;
+			dst[count * channels + j] = fft_kernels_dot(dec->coeffs,
+														history + dec->pos,
+														dec->taps);
+		}
+		++count;
+	}
+
+	return count;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function frees all data and data structures used by the decimator.
+//
+//------------------------------------------------------------------------------
+void fft_decimator_free(fft_decimator * dec)
+{
+	if (dec == NULL) {
+		return;
+	}
+
+	free(dec->coeffs);
+	free(dec->history);
+	free(dec);
+}
@@ -0,0 +1,116 @@
+//------------------------------------------------------------------------------
+//
+// FFT_DECIMATOR
+//
+// MODULE TO DECIMATE A STREAM OF AUDIO SAMPLES BY AN INTEGER FACTOR.
+//
+// This module provides a streaming anti-aliasing FIR low-pass filter followed
+// by a downsampler of interleaved audio samples. Only the retained outputs are
+// filtered (polyphase style), so each input sample costs about TAPS / factor
+// multiply-adds.
+// Its purpose is to feed FFTs that need a fine frequency resolution in the
+// lowest part of the spectrum without transforming a long window at the full
+// samplerate.
+// All functions are thread UNSAFE: each decimator must be used by one thread
+// at a time.
+//
+//------------------------------------------------------------------------------
+#ifndef FFT_DECIMATOR_H
+#define FFT_DECIMATOR_H
+
+
+#include <stdlib.h>
+
+
+//------------------------------------------------------------------------------
+// FFT_DECIMATOR GLOBAL CONSTANTS
+//------------------------------------------------------------------------------
+#define FFT_DECIMATOR_SUCCESS		0
+#define FFT_DECIMATOR_ERROR			1
+
+// Fraction of the output band [0, samplerate / (2 * factor)] free of aliasing
+#define FFT_DECIMATOR_PASSBAND		0.8f
+
+
+//------------------------------------------------------------------------------
+// FFT_DECIMATOR GLOBAL STRUCTURES DECLARATION
+//------------------------------------------------------------------------------
+typedef struct fft_decimator fft_decimator;
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function creates a new decimator by "factor" of "channels" interleaved
+// channels. Its filter has unity gain up to FFT_DECIMATOR_PASSBAND of the
+// output band and rejects everything that would alias into it. The filter
+// history starts with silence.
+//
+// PARAMETERS
+// dec: where the pointer to the new decimator is stored
+// factor: the decimation factor, greater than 1
+// channels: the number of interleaved channels, greater than 0
+//
+// RETURN
+// If the decimator cannot be allocated, this function returns
+// FFT_DECIMATOR_ERROR and "dec" is set to NULL.
+// Otherwise it returns FFT_DECIMATOR_SUCCESS.
+//
+//------------------------------------------------------------------------------
+int fft_decimator_init(fft_decimator ** dec,
+					   const size_t factor,
+					   const size_t channels);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the decimation factor of the decimator.
+//
+// PARAMETERS
+// dec: the decimator
+//
+// RETURN
+// The decimation factor of the decimator.
+//
+//------------------------------------------------------------------------------
+size_t fft_decimator_get_factor(const fft_decimator * dec);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function filters "n" input samples of each channel and stores the
+// decimated ones, interleaved, in "dst". The samples are a continuation of the
+// ones of the previous call, so a stream can be decimated in blocks of any
+// length. At most n / factor + 1 samples of each channel are stored.
+//
+// PARAMETERS
+// dec: the decimator
+// dst: the buffer where the decimated samples are stored
+// src: the buffer of "n * channels" interleaved input samples
+// n: the number of input samples of each channel
+//
+// RETURN
+// The number of decimated samples of each channel stored in "dst".
+//
+//------------------------------------------------------------------------------
+size_t fft_decimator_process(fft_decimator * dec,
+							 float * dst,
+							 const float * src,
+							 const size_t n);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function frees all data and data structures used by the decimator.
+//
+// PARAMETERS
+// dec: the decimator to be freed, it may be NULL
+//
+//------------------------------------------------------------------------------
+void fft_decimator_free(fft_decimator * dec);
+
+
+#endif
@@ -0,0 +1,314 @@
+#include "fft_filterbank.h"
+#include "fft_kernels.h"
+#include <math.h>
+#include <assert.h>
+
+
+//------------------------------------------------------------------------------
+// FFT_FILTERBANK LOCAL MACROS
+//------------------------------------------------------------------------------
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+
+
+//------------------------------------------------------------------------------
+// FFT_FILTERBANK LOCAL STRUCT DEFINITIONS
+//------------------------------------------------------------------------------
+struct fft_filterbank {
+	float * weights;							// Weights of all bands
+	size_t * offset;							// First weight of each band,
+												// plus the total num. of them
+	size_t * first;								// First bin of each band
+	float * center;								// Center frequency of bands
+	size_t bands;								// Num. of bands
+	size_t spectrum_samples;					// Num. of bins of the spectrum
+	float bin_freq;								// Frequency step of the bins
+};
+
+
+//------------------------------------------------------------------------------
+//
+// This function is a help function that maps a frequency in Hz on the provided
+// scale.
+//
+//------------------------------------------------------------------------------
+static double fft_filterbank_warp(const fft_filterbank_scale scale,
+								  const double freq)
+{
+	switch (scale) {
+		case fft_filterbank_bark:
+			return 26.81 * freq / (1960.0 + freq) - 0.53;
+		case fft_filterbank_constant_q:
+			return log2(freq);
+		case fft_filterbank_mel:
+		default:
+			return 2595.0 * log10(1.0 + freq / 700.0);
+	}
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function is a help function that maps a value of the provided scale
+// back to a frequency in Hz.
+//
+//------------------------------------------------------------------------------
+static double fft_filterbank_unwarp(const fft_filterbank_scale scale,
+									const double val)
+{
+	switch (scale) {
+		case fft_filterbank_bark:
+			return 1960.0 * (val + 0.53) / (26.28 - val);
+		case fft_filterbank_constant_q:
+			return exp2(val);
+		case fft_filterbank_mel:
+		default:
+			return 700.0 * (pow(10.0, val / 2595.0) - 1.0);
+	}
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function is a help function that calculates the contiguous run of bins
+// [first, first + count) covered by the triangular filter with the provided
+// edges and center, and stores their weights in "weights" if it is not NULL.
+// The weights are normalized to sum to 1.
+// It returns the number of bins of the run.
+//
+//------------------------------------------------------------------------------
+static size_t fft_filterbank_fill_band(const fft_filterbank * fb,
+									   const double lo,
+									   const double center,
+									   const double hi,
+									   size_t * first,
+									   float * weights)
+{
+	size_t i;
+	size_t last;
+	double freq;
+	double sum = 0.0;
+
+	// Only the bins strictly inside the edges have a weight greater than 0
+	*first = (size_t)floor(lo / fb->bin_freq) + 1;
+	last = MIN((size_t)ceil(hi / fb->bin_freq) - 1, fb->spectrum_samples - 1);
+
+	if (*first > last) {
+		*first = MIN((size_t)lround(center / fb->bin_freq),
+					 fb->spectrum_samples - 1);
+		if (weights != NULL) {
+			weights[0] = 1.0f;
+		}
+		return 1;
+	}
+
+	if (weights == NULL) {
+		return last - *first + 1;
+	}
+
+	for (i = *first; i <= last; ++i) {
+		freq = i * fb->bin_freq;
+		if (freq <= center) {
+			weights[i - *first] = (freq - lo) / (center - lo);
+		} else {
+			weights[i - *first] = (hi - freq) / (hi - center);
+		}
+		sum += weights[i - *first];
+	}
+
+	for (i = *first; i <= last; ++i) {
+		weights[i - *first] /= sum;
+	}
+
+	return last - *first + 1;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function creates a new filterbank of "bands" triangular filters. The
+// weights are computed in two passes: the first one sizes the sparse matrix,
+// the second one fills it.
+//
+//------------------------------------------------------------------------------
+int fft_filterbank_init(fft_filterbank ** fb_ptr,
+						const fft_filterbank_scale scale,
+						const size_t bands,
+						const float min_freq,
+						const float max_freq,
+						const size_t fft_samples,
+						const float samplerate)
+{
+	size_t i;
+	double * edges;
+	double warp_min;
+	double warp_step;
+	fft_filterbank * fb;
+
+	assert(fb_ptr != NULL);
+	assert(bands > 0);
+	assert(min_freq >= 0.0f && min_freq < max_freq);
+	assert(scale != fft_filterbank_constant_q || min_freq > 0.0f);
+	assert(fft_samples > 0 && samplerate > 0.0f);
+
+	*fb_ptr = NULL;
+
+	fb = calloc(1, sizeof(fft_filterbank));
+	edges = malloc((bands + 2) * sizeof(double));
+	if (fb == NULL || edges == NULL) {
+		free(edges);
+		fft_filterbank_free(fb);
+		return FFT_FILTERBANK_ERROR;
+	}
+
+	fb->bands = bands;
+	fb->spectrum_samples = fft_samples / 2 + 1;
+	fb->bin_freq = samplerate / fft_samples;
+
+	warp_min = fft_filterbank_warp(scale, min_freq);
+	warp_step = (fft_filterbank_warp(scale, max_freq) - warp_min) / (bands + 1);
+	for (i = 0; i < bands + 2; ++i) {
+		edges[i] = fft_filterbank_unwarp(scale, warp_min + i * warp_step);
+	}
+
+	fb->offset = malloc((bands + 1) * sizeof(size_t));
+	fb->first = malloc(bands * sizeof(size_t));
+	fb->center = malloc(bands * sizeof(float));
+	if (fb->offset == NULL || fb->first == NULL || fb->center == NULL) {
+		free(edges);
+		fft_filterbank_free(fb);
+		return FFT_FILTERBANK_ERROR;
+	}
+
+	fb->offset[0] = 0;
+	for (i = 0; i < bands; ++i) {
+		fb->center[i] = edges[i + 1];
+		fb->offset[i + 1] = fb->offset[i] +
+							fft_filterbank_fill_band(fb, edges[i], edges[i + 1],
+													 edges[i + 2],
+													 &fb->first[i], NULL);
+	}
+
+	fb->weights = malloc(fb->offset[bands] * sizeof(float));
+	if (fb->weights == NULL) {
+		free(edges);
+		fft_filterbank_free(fb);
+		return FFT_FILTERBANK_ERROR;
+	}
+
+	for (i = 0; i < bands; ++i) {
+		fft_filterbank_fill_band(fb, edges[i], edges[i + 1], edges[i + 2],
+								 &fb->first[i], fb->weights + fb->offset[i]);
+	}
+
+	free(edges);
+	*fb_ptr = fb;
+	return FFT_FILTERBANK_SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the number of bands of the filterbank.
+//
+//------------------------------------------------------------------------------
+size_t fft_filterbank_get_bands(const fft_filterbank * fb)
+{
+	assert(fb != NULL);
+
+	return fb->bands;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the center frequency of a band of the filterbank.
+//
+//------------------------------------------------------------------------------
+float fft_filterbank_get_center_freq(const fft_filterbank * fb,
+									 const size_t band)
+{
+	assert(fb != NULL);
+	assert(band < fb->bands);
+
+	return fb->center[band];
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the contiguous run of bins covered by a band of the
+// filterbank.
+//
+//------------------------------------------------------------------------------
+size_t fft_filterbank_get_bins(const fft_filterbank * fb,
+							   const size_t band,
+							   size_t * first)
+{
+	assert(fb != NULL);
+	assert(band < fb->bands);
+	assert(first != NULL);
+
+	*first = fb->first[band];
+	return fb->offset[band + 1] - fb->offset[band];
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function applies one band of the filterbank to a magnitude spectrum, as
+// the dot product between its run of weights and the bins it covers.
+//
+//------------------------------------------------------------------------------
+float fft_filterbank_apply_band(const fft_filterbank * fb,
+								const float * mag,
+								const size_t band)
+{
+	assert(fb != NULL);
+	assert(mag != NULL);
+	assert(band < fb->bands);
+
+	return fft_kernels_dot(fb->weights + fb->offset[band],
+						   mag + fb->first[band],
+						   fb->offset[band + 1] - fb->offset[band]);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function applies the filterbank to a magnitude spectrum, one band after
+// the other.
+//
+//------------------------------------------------------------------------------
+void fft_filterbank_apply(const fft_filterbank * fb,
+						  const float * mag,
+						  float values[])
+{
+	size_t i;
+
+	assert(fb != NULL);
+	assert(mag != NULL);
+	assert(values != NULL);
+
+	for (i = 0; i < fb->bands; ++i) {
+		values[i] = fft_filterbank_apply_band(fb, mag, i);
+	}
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function frees all data and data structures used by the filterbank.
+//
+//------------------------------------------------------------------------------
+void fft_filterbank_free(fft_filterbank * fb)
+{
+	if (fb == NULL) {
+		return;
+	}
+
+	free(fb->weights);
+	free(fb->offset);
+	free(fb->first);
+	free(fb->center);
+	free(fb);
+}
@@ -0,0 +1,189 @@
+//------------------------------------------------------------------------------
+//
+// FFT_FILTERBANK
+//
+// MODULE TO MAP A MAGNITUDE SPECTRUM INTO PERCEPTUAL BANDS.
+//
+// This module provides filterbanks of triangular filters whose edges are
+// equally spaced on the mel, Bark or logarithmic (constant-Q) frequency scale.
+// The weights are computed once, when the filterbank is created for a given
+// FFT length, samplerate and number of bands, and are stored as a sparse
+// matrix: each band keeps only the contiguous run of bins it covers. Applying
+// the filterbank to a spectrum is then a single pass of vectorized dot
+// products, and the same filterbank can be shared by every consumer.
+// Applying a filterbank is thread safe; creating and freeing it are not.
+// fft_audio builds on it the bands of a context, see fft_audio_filterbank.
+//
+//------------------------------------------------------------------------------
+#ifndef FFT_FILTERBANK_H
+#define FFT_FILTERBANK_H
+
+
+#include <stdlib.h>
+
+
+//------------------------------------------------------------------------------
+// FFT_FILTERBANK GLOBAL CONSTANTS
+//------------------------------------------------------------------------------
+#define FFT_FILTERBANK_SUCCESS		0
+#define FFT_FILTERBANK_ERROR		1
+
+
+//------------------------------------------------------------------------------
+// FFT_FILTERBANK GLOBAL ENUMS DECLARATION
+//------------------------------------------------------------------------------
+typedef enum {
+	fft_filterbank_mel = 0,			// mel scale, linear below ~1 kHz
+	fft_filterbank_bark,			// Bark scale of the critical bands
+	fft_filterbank_constant_q		// logarithmic scale, constant Q factor
+} fft_filterbank_scale;
+
+
+//------------------------------------------------------------------------------
+// FFT_FILTERBANK GLOBAL STRUCTURES DECLARATION
+//------------------------------------------------------------------------------
+typedef struct fft_filterbank fft_filterbank;
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function creates a new filterbank of "bands" triangular filters over
+// the spectrum of an FFT of "fft_samples" samples at "samplerate".
+// The "bands + 2" edges of the filters are equally spaced on the chosen scale
+// between "min_freq" and "max_freq": each filter rises from its lower edge to
+// its center, which is the lower edge of the next filter, and falls to zero at
+// its upper edge. The weights of each filter sum to 1, so that the value of a
+// band is a weighted average of the magnitudes it covers. A filter narrower
+// than the spacing of the bins takes the bin nearest to its center.
+//
+// PARAMETERS
+// fb: where the pointer to the new filterbank is stored
+// scale: the frequency scale on which the filters are equally spaced
+// bands: the number of bands, greater than 0
+// min_freq: the lower edge of the first filter in Hz, greater than 0 for
+//           fft_filterbank_constant_q
+// max_freq: the upper edge of the last filter in Hz, greater than "min_freq"
+// fft_samples: the length of the FFT whose spectrum is mapped
+// samplerate: the samplerate of the transformed audio, which may be fractional
+//             (e.g. that of a decimated signal)
+//
+// RETURN
+// If the filterbank cannot be allocated, this function returns
+// FFT_FILTERBANK_ERROR and "fb" is set to NULL.
+// Otherwise it returns FFT_FILTERBANK_SUCCESS.
+//
+//------------------------------------------------------------------------------
+int fft_filterbank_init(fft_filterbank ** fb,
+						const fft_filterbank_scale scale,
+						const size_t bands,
+						const float min_freq,
+						const float max_freq,
+						const size_t fft_samples,
+						const float samplerate);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the number of bands of the filterbank.
+//
+// PARAMETERS
+// fb: the filterbank
+//
+// RETURN
+// The number of bands of the filterbank.
+//
+//------------------------------------------------------------------------------
+size_t fft_filterbank_get_bands(const fft_filterbank * fb);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the center frequency of a band of the filterbank.
+//
+// PARAMETERS
+// fb: the filterbank
+// band: the band, lower than the number of bands
+//
+// RETURN
+// The center frequency of the band in Hz.
+//
+//------------------------------------------------------------------------------
+float fft_filterbank_get_center_freq(const fft_filterbank * fb,
+									 const size_t band);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns the contiguous run of bins [first, first + count)
+// covered by a band of the filterbank, i.e. the bins its value is made of.
+//
+// PARAMETERS
+// fb: the filterbank
+// band: the band, lower than the number of bands
+// first: where the first bin of the band is stored
+//
+// RETURN
+// The number of bins of the band, greater than 0.
+//
+//------------------------------------------------------------------------------
+size_t fft_filterbank_get_bins(const fft_filterbank * fb,
+							   const size_t band,
+							   size_t * first);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function applies one band of the filterbank to a magnitude spectrum:
+// value = sum of weight[band][i] * mag[i] over the bins i of the band
+// Only the bins of the band are read, see fft_filterbank_get_bins().
+//
+// PARAMETERS
+// fb: the filterbank
+// mag: the magnitudes of the spectrum
+// band: the band, lower than the number of bands
+//
+// RETURN
+// The value of the band.
+//
+//------------------------------------------------------------------------------
+float fft_filterbank_apply_band(const fft_filterbank * fb,
+								const float * mag,
+								const size_t band);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function applies the filterbank to a magnitude spectrum, computing the
+// value of every band in a single pass:
+// values[b] = sum of weight[b][i] * mag[i] over the bins i of the band "b"
+//
+// PARAMETERS
+// fb: the filterbank
+// mag: the fft_samples / 2 + 1 magnitudes of the spectrum
+// values: the array of "bands" values to be filled
+//
+//------------------------------------------------------------------------------
+void fft_filterbank_apply(const fft_filterbank * fb,
+						  const float * mag,
+						  float values[]);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function frees all data and data structures used by the filterbank.
+//
+// PARAMETERS
+// fb: the filterbank to be freed, it may be NULL
+//
+//------------------------------------------------------------------------------
+void fft_filterbank_free(fft_filterbank * fb);
+
+
+#endif
@@ -0,0 +1,1044 @@
+#include "fft_kernels.h"
+#include <float.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <assert.h>
+
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+	#define FFT_KERNELS_SSE
+#elif defined(__ARM_NEON)
+	#include <arm_neon.h>
+	#define FFT_KERNELS_NEON
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#include <immintrin.h>
+	#define FFT_KERNELS_DISPATCH
+#endif
+
+
+//------------------------------------------------------------------------------
+// FFT_KERNELS LOCAL CONSTANTS
+//------------------------------------------------------------------------------
+#define VECTOR_SAMPLES		4		// Num. of float values in a SIMD register
+#define VECTOR_SAMPLES_AVX	8		// Num. of float values in an AVX register
+#define VECTOR_SAMPLES_512	16		// Num. of float values in a 512 bits reg.
+
+// Coefficients of the series log2(m) = 2 / ln(2) * (z + z^3 / 3 + ...), with
+// z = (m - 1) / (m + 1). The mantissa is reduced to [sqrt(1/2), sqrt(2)), so
+// |z| < 0.172 and the terms after z^7 sum to less than 5e-8
+#define LOG2_C1				2.8853900817779268f		// 2 / ln(2)
+#define LOG2_C3				0.9617966939259756f		// 2 / (3 * ln(2))
+#define LOG2_C5				0.5770780163555854f		// 2 / (5 * ln(2))
+#define LOG2_C7				0.4121985831111324f		// 2 / (7 * ln(2))
+#define SQRT2				1.4142135623730951f
+
+#define FLOAT_EXP_BIAS		127
+#define FLOAT_MANT_BITS		23
+#define FLOAT_MANT_MASK		0x007FFFFF
+#define FLOAT_ONE_BITS		0x3F800000		// Bits of 1.0f
+
+
+//------------------------------------------------------------------------------
+// FFT_KERNELS LOCAL MACROS
+//------------------------------------------------------------------------------
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+
+
+//------------------------------------------------------------------------------
+// FFT_KERNELS LOCAL TYPES
+//------------------------------------------------------------------------------
+typedef size_t (*magnitude_kernel)(float * mag,
+								   const float spectrum[][2],
+								   const size_t n,
+								   fft_kernels_reduction * reduction);
+
+
+//------------------------------------------------------------------------------
+// FFT_KERNELS LOCAL DATA
+//------------------------------------------------------------------------------
+static pthread_once_t dispatch_once = PTHREAD_ONCE_INIT;
+static magnitude_kernel magnitude_simd;		// best kernel of the running CPU
+
+
+//------------------------------------------------------------------------------
+//
+// This function is the scalar fallback of the downmix kernel. It also computes
+// the last values that do not fill a SIMD register.
+//
+//------------------------------------------------------------------------------
+static void fft_kernels_downmix_scalar(float * dst,
+									   const float * src,
+									   const float * window,
+									   const size_t from,
+									   const size_t n,
+									   const size_t channels,
+									   const float scale)
+{
+	size_t i;
+	size_t j;
+	float sum;
+
+	for (i = from; i < n; ++i) {
+		sum = 0.0f;
+		for (j = 0; j < channels; ++j) {
+			sum += src[i * channels + j];
+		}
+		sum *= scale;
+		dst[i] = (window != NULL) ? sum * window[i] : sum;
+	}
+}
+
+
+#if defined(FFT_KERNELS_SSE)
+//------------------------------------------------------------------------------
+//
+// This function is the SSE downmix kernel of mono and stereo audio. Stereo
+// values are deinterleaved by shuffling two registers of L/R pairs.
+// It returns the number of values computed.
+//
+//------------------------------------------------------------------------------
+static size_t fft_kernels_downmix_simd(float * dst,
+									   const float * src,
+									   const float * window,
+									   const size_t n,
+									   const size_t channels,
+									   const float scale)
+{
+	size_t i;
+	__m128 lo;
+	__m128 hi;
+	__m128 sum;
+	const __m128 s = _mm_set1_ps(scale);
+
+	if (channels > 2) {
+		return 0;
+	}
+
+	for (i = 0; i + VECTOR_SAMPLES <= n; i += VECTOR_SAMPLES) {
+		if (channels == 1) {
+			sum = _mm_loadu_ps(src + i);
+		} else {
+			lo = _mm_loadu_ps(src + 2 * i);
+			hi = _mm_loadu_ps(src + 2 * i + VECTOR_SAMPLES);
+			sum = _mm_add_ps(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)),
+							 _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+		sum = _mm_mul_ps(sum, s);
+		if (window != NULL) {
+			sum = _mm_mul_ps(sum, _mm_loadu_ps(window + i));
+		}
+		_mm_storeu_ps(dst + i, sum);
+	}
+
+	return i;
+}
+#elif defined(FFT_KERNELS_NEON)
+//------------------------------------------------------------------------------
+//
+// This function is the NEON downmix kernel of mono and stereo audio. Stereo
+// values are deinterleaved by a de-interleaving load of L/R pairs.
+// It returns the number of values computed.
+//
+//------------------------------------------------------------------------------
+static size_t fft_kernels_downmix_simd(float * dst,
+									   const float * src,
+									   const float * window,
+									   const size_t n,
+									   const size_t channels,
+									   const float scale)
+{
+	size_t i;
+	float32x4x2_t lr;
+	float32x4_t sum;
+
+	if (channels > 2) {
+		return 0;
+	}
+
+	for (i = 0; i + VECTOR_SAMPLES <= n; i += VECTOR_SAMPLES) {
+		if (channels == 1) {
+			sum = vld1q_f32(src + i);
+		} else {
+			lr = vld2q_f32(src + 2 * i);
+			sum = vaddq_f32(lr.val[0], lr.val[1]);
+		}
+		sum = vmulq_n_f32(sum, scale);
+		if (window != NULL) {
+			sum = vmulq_f32(sum, vld1q_f32(window + i));
+		}
+		vst1q_f32(dst + i, sum);
+	}
+
+	return i;
+}
+#else
+//------------------------------------------------------------------------------
+//
+// This function is used when no SIMD instruction set is available: every value
+// is computed by the scalar fallback.
+//
+//------------------------------------------------------------------------------
+static size_t fft_kernels_downmix_simd(float * dst,
+									   const float * src,
+									   const float * window,
+									   const size_t n,
+									   const size_t channels,
+									   const float scale)
+{
+	return 0;
+}
+#endif
+
+
+//------------------------------------------------------------------------------
+//
+// This function downmixes, scales and windows "n" interleaved audio samples in
+// a single pass, vectorizing mono and stereo audio.
+//
+//------------------------------------------------------------------------------
+void fft_kernels_downmix(float * dst,
+						 const float * src,
+						 const float * window,
+						 const size_t n,
+						 const size_t channels,
+						 const float scale)
+{
+	size_t done;
+
+	assert(dst != NULL);
+	assert(n == 0 || src != NULL);
+	assert(channels > 0);
+
+	done = fft_kernels_downmix_simd(dst, src, window, n, channels, scale);
+	fft_kernels_downmix_scalar(dst, src, window, done, n, channels, scale);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function is the scalar fallback of the deinterleave kernel. It also
+// computes the last values that do not fill a SIMD register.
+//
+//------------------------------------------------------------------------------
+static void fft_kernels_deinterleave_scalar(float * const dst[],
+										   const float * src,
+										   const float * window,
+										   const size_t from,
+										   const size_t n,
+										   const size_t channels,
+										   const float scale)
+{
+	size_t i;
+	size_t j;
+	float val;
+
+	for (i = from; i < n; ++i) {
+		for (j = 0; j < channels; ++j) {
+			val = scale * src[i * channels + j];
+			dst[j][i] = (window != NULL) ? val * window[i] : val;
+		}
+	}
+}
+
+
+#if defined(FFT_KERNELS_SSE)
+//------------------------------------------------------------------------------
+//
+// This function is the SSE deinterleave kernel of mono and stereo audio.
+// Stereo values are split by shuffling two registers of L/R pairs.
+// It returns the number of values computed.
+//
+//------------------------------------------------------------------------------
+static size_t fft_kernels_deinterleave_simd(float * const dst[],
+											const float * src,
+											const float * window,
+											const size_t n,
+											const size_t channels,
+											const float scale)
+{
+	size_t i;
+	__m128 lo;
+	__m128 hi;
+	__m128 l;
+	__m128 r;
+	__m128 w;
+	const __m128 s = _mm_set1_ps(scale);
+
+	if (channels > 2) {
+		return 0;
+	}
+
+	for (i = 0; i + VECTOR_SAMPLES <= n; i += VECTOR_SAMPLES) {
+		w = (window != NULL) ? _mm_mul_ps(s, _mm_loadu_ps(window + i)) : s;
+		if (channels == 1) {
+			_mm_storeu_ps(dst[0] + i, _mm_mul_ps(_mm_loadu_ps(src + i), w));
+			continue;
+		}
+		lo = _mm_loadu_ps(src + 2 * i);
+		hi = _mm_loadu_ps(src + 2 * i + VECTOR_SAMPLES);
+		l = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+		r = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+		_mm_storeu_ps(dst[0] + i, _mm_mul_ps(l, w));
+		_mm_storeu_ps(dst[1] + i, _mm_mul_ps(r, w));
+	}
+
+	return i;
+}
+#elif defined(FFT_KERNELS_NEON)
+//------------------------------------------------------------------------------
+//
+// This function is the NEON deinterleave kernel of mono and stereo audio.
+// Stereo values are split by a de-interleaving load of L/R pairs.
+// It returns the number of values computed.
+//
+//------------------------------------------------------------------------------
+static size_t fft_kernels_deinterleave_simd(float * const dst[],
+											const float * src,
+											const float * window,
+											const size_t n,
+											const size_t channels,
+											const float scale)
+{
+	size_t i;
+	float32x4x2_t lr;
+	float32x4_t w;
+
+	if (channels > 2) {
+		return 0;
+	}
+
+	for (i = 0; i + VECTOR_SAMPLES <= n; i += VECTOR_SAMPLES) {
+		w = vdupq_n_f32(scale);
+		if (window != NULL) {
+			w = vmulq_f32(w, vld1q_f32(window + i));
+		}
+		if (channels == 1) {
+			vst1q_f32(dst[0] + i, vmulq_f32(vld1q_f32(src + i), w));
+			continue;
+		}
+		lr = vld2q_f32(src + 2 * i);
+		vst1q_f32(dst[0] + i, vmulq_f32(lr.val[0], w));
+		vst1q_f32(dst[1] + i, vmulq_f32(lr.val[1], w));
+	}
+
+	return i;
+}
+#else
+//------------------------------------------------------------------------------
+//
+// This function is used when no SIMD instruction set is available: every value
+// is computed by the scalar fallback.
+//
+//------------------------------------------------------------------------------
+static size_t fft_kernels_deinterleave_simd(float * const dst[],
+											const float * src,
+											const float * window,
+											const size_t n,
+											const size_t channels,
+											const float scale)
+{
+	return 0;
+}
+#endif
+
+
+//------------------------------------------------------------------------------
+//
+// This function splits "n" interleaved audio samples into one buffer per
+// channel, scaling and windowing them in a single pass, vectorizing mono and
+// stereo audio.
+//
+//------------------------------------------------------------------------------
+void fft_kernels_deinterleave(float * const dst[],
+							  const float * src,
+							  const float * window,
+							  const size_t n,
+							  const size_t channels,
+							  const float scale)
+{
+	size_t done;
+
+	assert(dst != NULL);
+	assert(n == 0 || src != NULL);
+	assert(channels > 0);
+
+	done = fft_kernels_deinterleave_simd(dst, src, window, n, channels, scale);
+	fft_kernels_deinterleave_scalar(dst, src, window, done, n, channels, scale);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function is the scalar fallback of the magnitude kernel. It also
+// computes the last values that do not fill a SIMD register, updating the
+// reduction of the values already computed.
+//
+//------------------------------------------------------------------------------
+static void fft_kernels_magnitude_scalar(float * mag,
+										 const float spectrum[][2],
+										 const size_t from,
+										 const size_t n,
+										 fft_kernels_reduction * reduction)
+{
+	size_t i;
+	float val;
+
+	for (i = from; i < n; ++i) {
+		val = spectrum[i][0] * spectrum[i][0] + spectrum[i][1] * spectrum[i][1];
+		mag[i] = val;
+		reduction->min = MIN(reduction->min, val);
+		reduction->max = MAX(reduction->max, val);
+		reduction->sum += val;
+	}
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function is a help function that merges the partial reductions stored
+// in the "lanes" lanes of three SIMD registers into the reduction.
+//
+//------------------------------------------------------------------------------
+static void fft_kernels_reduce_lanes(const float * min,
+									 const float * max,
+									 const float * sum,
+									 const size_t lanes,
+									 fft_kernels_reduction * reduction)
+{
+	size_t i;
+
+	for (i = 0; i < lanes; ++i) {
+		reduction->min = MIN(reduction->min, min[i]);
+		reduction->max = MAX(reduction->max, max[i]);
+		reduction->sum += sum[i];
+	}
+}
+
+
+#if defined(FFT_KERNELS_SSE)
+//------------------------------------------------------------------------------
+//
+// This function is the SSE2 magnitude kernel. The squares of two registers of
+// complex values are split into real and imaginary parts by shuffling.
+// It returns the number of values computed.
+//
+//------------------------------------------------------------------------------
+static size_t fft_kernels_magnitude_sse(float * mag,
+										const float spectrum[][2],
+										const size_t n,
+										fft_kernels_reduction * reduction)
+{
+	size_t i;
+	__m128 lo;
+	__m128 hi;
+	__m128 val;
+	__m128 min = _mm_set1_ps(FLT_MAX);
+	__m128 max = _mm_set1_ps(FLT_MIN);
+	__m128 sum = _mm_setzero_ps();
+	float lanes[3][VECTOR_SAMPLES];
+
+	for (i = 0; i + VECTOR_SAMPLES <= n; i += VECTOR_SAMPLES) {
+		lo = _mm_loadu_ps(spectrum[i]);
+		hi = _mm_loadu_ps(spectrum[i + 2]);
+		lo = _mm_mul_ps(lo, lo);
+		hi = _mm_mul_ps(hi, hi);
+		val = _mm_add_ps(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)),
+						 _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+		_mm_storeu_ps(mag + i, val);
+		min = _mm_min_ps(min, val);
+		max = _mm_max_ps(max, val);
+		sum = _mm_add_ps(sum, val);
+	}
+
+	_mm_storeu_ps(lanes[0], min);
+	_mm_storeu_ps(lanes[1], max);
+	_mm_storeu_ps(lanes[2], sum);
+	fft_kernels_reduce_lanes(lanes[0], lanes[1], lanes[2],
+							 VECTOR_SAMPLES, reduction);
+
+	return i;
+}
+#elif defined(FFT_KERNELS_NEON)
+//------------------------------------------------------------------------------
+//
+// This function is the NEON magnitude kernel. Complex values are split into
+// real and imaginary parts by a de-interleaving load.
+// It returns the number of values computed.
+//
+//------------------------------------------------------------------------------
+static size_t fft_kernels_magnitude_neon(float * mag,
+										 const float spectrum[][2],
+										 const size_t n,
+										 fft_kernels_reduction * reduction)
+{
+	size_t i;
+	float32x4x2_t ri;
+	float32x4_t val;
+	float32x4_t min = vdupq_n_f32(FLT_MAX);
+	float32x4_t max = vdupq_n_f32(FLT_MIN);
+	float32x4_t sum = vdupq_n_f32(0.0f);
+	float lanes[3][VECTOR_SAMPLES];
+
+	for (i = 0; i + VECTOR_SAMPLES <= n; i += VECTOR_SAMPLES) {
+		ri = vld2q_f32(spectrum[i]);
+		val = vaddq_f32(vmulq_f32(ri.val[0], ri.val[0]),
+						vmulq_f32(ri.val[1], ri.val[1]));
+		vst1q_f32(mag + i, val);
+		min = vminq_f32(min, val);
+		max = vmaxq_f32(max, val);
+		sum = vaddq_f32(sum, val);
+	}
+
+	vst1q_f32(lanes[0], min);
+	vst1q_f32(lanes[1], max);
+	vst1q_f32(lanes[2], sum);
+	fft_kernels_reduce_lanes(lanes[0], lanes[1], lanes[2],
+							 VECTOR_SAMPLES, reduction);
+
+	return i;
+}
+#endif
+
+
+#if defined(FFT_KERNELS_DISPATCH)
+//------------------------------------------------------------------------------
+//
+// This function is the AVX2 magnitude kernel. The squares of two registers of
+// complex values are added pairwise and the 64 bits halves are reordered.
+// It returns the number of values computed.
+//
+//------------------------------------------------------------------------------
+__attribute__((target("avx2")))
+static size_t fft_kernels_magnitude_avx2(float * mag,
+										 const float spectrum[][2],
+										 const size_t n,
+										 fft_kernels_reduction * reduction)
+{
+	size_t i;
+	__m256 lo;
+	__m256 hi;
+	__m256 val;
+	__m256 min = _mm256_set1_ps(FLT_MAX);
+	__m256 max = _mm256_set1_ps(FLT_MIN);
+	__m256 sum = _mm256_setzero_ps();
+	float lanes[3][VECTOR_SAMPLES_AVX];
+
+	for (i = 0; i + VECTOR_SAMPLES_AVX <= n; i += VECTOR_SAMPLES_AVX) {
+		lo = _mm256_loadu_ps(spectrum[i]);
+		hi = _mm256_loadu_ps(spectrum[i + 4]);
+		val = _mm256_hadd_ps(_mm256_mul_ps(lo, lo), _mm256_mul_ps(hi, hi));
+		val = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(val),
+													 _MM_SHUFFLE(3, 1, 2, 0)));
+		_mm256_storeu_ps(mag + i, val);
+		min = _mm256_min_ps(min, val);
+		max = _mm256_max_ps(max, val);
+		sum = _mm256_add_ps(sum, val);
+	}
+
+	_mm256_storeu_ps(lanes[0], min);
+	_mm256_storeu_ps(lanes[1], max);
+	_mm256_storeu_ps(lanes[2], sum);
+	fft_kernels_reduce_lanes(lanes[0], lanes[1], lanes[2],
+							 VECTOR_SAMPLES_AVX, reduction);
+
+	return i;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function is the AVX-512 magnitude kernel. The squares of two registers
+// of complex values are split into real and imaginary parts by permutation.
+// It returns the number of values computed.
+//
+//------------------------------------------------------------------------------
+__attribute__((target("avx512f")))
+static size_t fft_kernels_magnitude_avx512(float * mag,
+										   const float spectrum[][2],
+										   const size_t n,
+										   fft_kernels_reduction * reduction)
+{
+	size_t i;
+	__m512 lo;
+	__m512 hi;
+	__m512 val;
+	__m512 min = _mm512_set1_ps(FLT_MAX);
+	__m512 max = _mm512_set1_ps(FLT_MIN);
+	__m512 sum = _mm512_setzero_ps();
+	const __m512i even = _mm512_set_epi32(30, 28, 26, 24, 22, 20, 18, 16,
+										  14, 12, 10, 8, 6, 4, 2, 0);
+	const __m512i odd = _mm512_set_epi32(31, 29, 27, 25, 23, 21, 19, 17,
+										 15, 13, 11, 9, 7, 5, 3, 1);
+	float lanes[3][VECTOR_SAMPLES_512];
+
+	for (i = 0; i + VECTOR_SAMPLES_512 <= n; i += VECTOR_SAMPLES_512) {
+		lo = _mm512_loadu_ps(spectrum[i]);
+		hi = _mm512_loadu_ps(spectrum[i + 8]);
+		lo = _mm512_mul_ps(lo, lo);
+		hi = _mm512_mul_ps(hi, hi);
+		val = _mm512_add_ps(_mm512_permutex2var_ps(lo, even, hi),
+							_mm512_permutex2var_ps(lo, odd, hi));
+		_mm512_storeu_ps(mag + i, val);
+		min = _mm512_min_ps(min, val);
+		max = _mm512_max_ps(max, val);
+		sum = _mm512_add_ps(sum, val);
+	}
+
+	_mm512_storeu_ps(lanes[0], min);
+	_mm512_storeu_ps(lanes[1], max);
+	_mm512_storeu_ps(lanes[2], sum);
+	fft_kernels_reduce_lanes(lanes[0], lanes[1], lanes[2],
+							 VECTOR_SAMPLES_512, reduction);
+
+	return i;
+}
+#endif
+
+
+//------------------------------------------------------------------------------
+//
+// This function selects, once per process, the best magnitude kernel
+// supported by the running CPU.
+//
+//------------------------------------------------------------------------------
+static void fft_kernels_dispatch()
+{
+	magnitude_simd = NULL;
+
+#if defined(FFT_KERNELS_SSE)
+	magnitude_simd = fft_kernels_magnitude_sse;
+#elif defined(FFT_KERNELS_NEON)
+	magnitude_simd = fft_kernels_magnitude_neon;
+#endif
+
+#if defined(FFT_KERNELS_DISPATCH)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		magnitude_simd = fft_kernels_magnitude_avx2;
+	}
+	if (__builtin_cpu_supports("avx512f")) {
+		magnitude_simd = fft_kernels_magnitude_avx512;
+	}
+#endif
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function computes the magnitude of "n" complex values and reduces them
+// to their minimum, maximum and sum, using the best kernel of the running CPU.
+//
+//------------------------------------------------------------------------------
+void fft_kernels_magnitude(float * mag,
+						   const float spectrum[][2],
+						   const size_t n,
+						   fft_kernels_reduction * reduction)
+{
+	size_t done = 0;
+
+	assert(mag != NULL);
+	assert(n == 0 || spectrum != NULL);
+	assert(reduction != NULL);
+
+	pthread_once(&dispatch_once, fft_kernels_dispatch);
+
+	reduction->min = FLT_MAX;
+	reduction->max = FLT_MIN;
+	reduction->sum = 0.0f;
+
+	if (magnitude_simd != NULL) {
+		done = magnitude_simd(mag, spectrum, n, reduction);
+	}
+	fft_kernels_magnitude_scalar(mag, spectrum, done, n, reduction);
+}
+
+
+#if defined(FFT_KERNELS_SSE)
+//------------------------------------------------------------------------------
+//
+// This function is the SSE dot product kernel. Two registers accumulate
+// alternate blocks of values, hiding the latency of the additions.
+// It stores the partial sum in "sum" and returns the number of values used.
+//
+//------------------------------------------------------------------------------
+static size_t fft_kernels_dot_simd(const float * a,
+								   const float * b,
+								   const size_t n,
+								   float * sum)
+{
+	size_t i;
+	float lanes[VECTOR_SAMPLES];
+	__m128 acc0 = _mm_setzero_ps();
+	__m128 acc1 = _mm_setzero_ps();
+
+	for (i = 0; i + 2 * VECTOR_SAMPLES <= n; i += 2 * VECTOR_SAMPLES) {
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i),
+										   _mm_loadu_ps(b + i)));
+		acc1 = _mm_add_ps(acc1,
+						  _mm_mul_ps(_mm_loadu_ps(a + i + VECTOR_SAMPLES),
+									 _mm_loadu_ps(b + i + VECTOR_SAMPLES)));
+	}
+
+	_mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+	*sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+
+	return i;
+}
+#elif defined(FFT_KERNELS_NEON)
+//------------------------------------------------------------------------------
+//
+// This function is the NEON dot product kernel. Two registers accumulate
+// alternate blocks of values, hiding the latency of the additions.
+// It stores the partial sum in "sum" and returns the number of values used.
+//
+//------------------------------------------------------------------------------
+static size_t fft_kernels_dot_simd(const float * a,
+								   const float * b,
+								   const size_t n,
+								   float * sum)
+{
+	size_t i;
+	float32x4_t acc0 = vdupq_n_f32(0.0f);
+	float32x4_t acc1 = vdupq_n_f32(0.0f);
+	float32x2_t half;
+
+	for (i = 0; i + 2 * VECTOR_SAMPLES <= n; i += 2 * VECTOR_SAMPLES) {
+		acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+		acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + VECTOR_SAMPLES),
+						 vld1q_f32(b + i + VECTOR_SAMPLES));
+	}
+
+	acc0 = vaddq_f32(acc0, acc1);
+	half = vadd_f32(vget_low_f32(acc0), vget_high_f32(acc0));
+	*sum = vget_lane_f32(vpadd_f32(half, half), 0);
+
+	return i;
+}
+#else
+//------------------------------------------------------------------------------
+//
+// This function is used when no SIMD instruction set is available: every value
+// is used by the scalar fallback.
+//
+//------------------------------------------------------------------------------
+static size_t fft_kernels_dot_simd(const float * a,
+								   const float * b,
+								   const size_t n,
+								   float * sum)
+{
+	*sum = 0.0f;
+	return 0;
+}
+#endif
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns the dot product of two buffers of "n" values.
+//
+//------------------------------------------------------------------------------
+float fft_kernels_dot(const float * a,
+					  const float * b,
+					  const size_t n)
+{
+	size_t i;
+	float sum;
+
+	assert(n == 0 || (a != NULL && b != NULL));
+
+	i = fft_kernels_dot_simd(a, b, n, &sum);
+	for (; i < n; ++i) {
+		sum += a[i] * b[i];
+	}
+
+	return sum;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function is the scalar fast log2 of a positive normal value. The value
+// is split into its exponent and its mantissa, which is reduced around 1 and
+// whose log2 is the odd series of z = (m - 1) / (m + 1).
+//
+//------------------------------------------------------------------------------
+static float fft_kernels_log2_scalar(const float x)
+{
+	uint32_t bits;
+	float m;
+	float e;
+	float z;
+	float z2;
+
+	memcpy(&bits, &x, sizeof(bits));
+	e = (float)((int32_t)(bits >> FLOAT_MANT_BITS) - FLOAT_EXP_BIAS);
+	bits = (bits & FLOAT_MANT_MASK) | FLOAT_ONE_BITS;
+	memcpy(&m, &bits, sizeof(m));
+
+	if (m > SQRT2) {
+		m *= 0.5f;
+		e += 1.0f;
+	}
+
+	z = (m - 1.0f) / (m + 1.0f);
+	z2 = z * z;
+
+	return e + z * (((LOG2_C7 * z2 + LOG2_C5) * z2 + LOG2_C3) * z2 + LOG2_C1);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function is the scalar fallback of the log-normalize kernel. It also
+// computes the last values that do not fill a SIMD register.
+//
+//------------------------------------------------------------------------------
+static void fft_kernels_log_normalize_scalar(float * state,
+											 const float * values,
+											 const size_t from,
+											 const size_t n,
+											 const float lo,
+											 const float inv,
+											 const float smoothing)
+{
+	size_t i;
+	float val;
+
+	for (i = from; i < n; ++i) {
+		if (!(values[i] > 0.0f && values[i] <= FLT_MAX)) {
+			state[i] = 0.0f;
+			continue;
+		}
+		val = fft_kernels_log2_scalar(MAX(values[i], FLT_MIN));
+		val = (val - lo) * inv;
+		state[i] = state[i] * smoothing + (1.0f - smoothing) * val;
+	}
+}
+
+
+#if defined(FFT_KERNELS_SSE)
+//------------------------------------------------------------------------------
+//
+// This function is the SSE fast log2 of four positive normal values, see
+// fft_kernels_log2_scalar(). The mantissas are reduced by masks instead of
+// branches.
+//
+//------------------------------------------------------------------------------
+static __m128 fft_kernels_log2_sse(const __m128 x)
+{
+	__m128i bits;
+	__m128 m;
+	__m128 e;
+	__m128 z;
+	__m128 z2;
+	__m128 big;
+	__m128 poly;
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	bits = _mm_castps_si128(x);
+	e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, FLOAT_MANT_BITS),
+									  _mm_set1_epi32(FLOAT_EXP_BIAS)));
+	bits = _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(FLOAT_MANT_MASK)),
+						_mm_set1_epi32(FLOAT_ONE_BITS));
+	m = _mm_castsi128_ps(bits);
+
+	big = _mm_cmpgt_ps(m, _mm_set1_ps(SQRT2));
+	m = _mm_mul_ps(m, _mm_or_ps(_mm_and_ps(big, _mm_set1_ps(0.5f)),
+								_mm_andnot_ps(big, one)));
+	e = _mm_add_ps(e, _mm_and_ps(big, one));
+
+	z = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one));
+	z2 = _mm_mul_ps(z, z);
+	poly = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(LOG2_C7), z2),
+					  _mm_set1_ps(LOG2_C5));
+	poly = _mm_add_ps(_mm_mul_ps(poly, z2), _mm_set1_ps(LOG2_C3));
+	poly = _mm_add_ps(_mm_mul_ps(poly, z2), _mm_set1_ps(LOG2_C1));
+
+	return _mm_add_ps(e, _mm_mul_ps(z, poly));
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function is the SSE log-normalize kernel. The values that are not
+// positive and finite are masked to 0.
+// It returns the number of values computed.
+//
+//------------------------------------------------------------------------------
+static size_t fft_kernels_log_normalize_simd(float * state,
+											 const float * values,
+											 const size_t n,
+											 const float lo,
+											 const float inv,
+											 const float smoothing)
+{
+	size_t i;
+	__m128 x;
+	__m128 val;
+	__m128 valid;
+	const __m128 l = _mm_set1_ps(lo);
+	const __m128 s = _mm_set1_ps(inv);
+	const __m128 a = _mm_set1_ps(smoothing);
+	const __m128 b = _mm_set1_ps(1.0f - smoothing);
+
+	for (i = 0; i + VECTOR_SAMPLES <= n; i += VECTOR_SAMPLES) {
+		x = _mm_loadu_ps(values + i);
+		valid = _mm_and_ps(_mm_cmpgt_ps(x, _mm_setzero_ps()),
+						   _mm_cmple_ps(x, _mm_set1_ps(FLT_MAX)));
+		x = _mm_max_ps(x, _mm_set1_ps(FLT_MIN));
+		val = _mm_mul_ps(_mm_sub_ps(fft_kernels_log2_sse(x), l), s);
+		val = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(state + i), a),
+						 _mm_mul_ps(val, b));
+		_mm_storeu_ps(state + i, _mm_and_ps(val, valid));
+	}
+
+	return i;
+}
+#elif defined(FFT_KERNELS_NEON)
+//------------------------------------------------------------------------------
+//
+// This function is the NEON fast log2 of four positive normal values, see
+// fft_kernels_log2_scalar(). The mantissas are reduced by masks instead of
+// branches, and the division is a reciprocal estimate refined by two
+// Newton-Raphson steps, since ARMv7 has no vector division.
+//
+//------------------------------------------------------------------------------
+static float32x4_t fft_kernels_log2_neon(const float32x4_t x)
+{
+	uint32x4_t bits;
+	uint32x4_t big;
+	float32x4_t m;
+	float32x4_t e;
+	float32x4_t z;
+	float32x4_t z2;
+	float32x4_t den;
+	float32x4_t rcp;
+	float32x4_t poly;
+	const float32x4_t one = vdupq_n_f32(1.0f);
+
+	bits = vreinterpretq_u32_f32(x);
+	e = vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(
+									vshrq_n_u32(bits, FLOAT_MANT_BITS)),
+								vdupq_n_s32(FLOAT_EXP_BIAS)));
+	bits = vorrq_u32(vandq_u32(bits, vdupq_n_u32(FLOAT_MANT_MASK)),
+					 vdupq_n_u32(FLOAT_ONE_BITS));
+	m = vreinterpretq_f32_u32(bits);
+
+	big = vcgtq_f32(m, vdupq_n_f32(SQRT2));
+	m = vbslq_f32(big, vmulq_n_f32(m, 0.5f), m);
+	e = vaddq_f32(e, vbslq_f32(big, one, vdupq_n_f32(0.0f)));
+
+	den = vaddq_f32(m, one);
+	rcp = vrecpeq_f32(den);
+	rcp = vmulq_f32(rcp, vrecpsq_f32(den, rcp));
+	rcp = vmulq_f32(rcp, vrecpsq_f32(den, rcp));
+	z = vmulq_f32(vsubq_f32(m, one), rcp);
+	z2 = vmulq_f32(z, z);
+	poly = vmlaq_n_f32(vdupq_n_f32(LOG2_C5), z2, LOG2_C7);
+	poly = vmlaq_f32(vdupq_n_f32(LOG2_C3), poly, z2);
+	poly = vmlaq_f32(vdupq_n_f32(LOG2_C1), poly, z2);
+
+	return vmlaq_f32(e, z, poly);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function is the NEON log-normalize kernel. The values that are not
+// positive and finite are masked to 0.
+// It returns the number of values computed.
+//
+//------------------------------------------------------------------------------
+static size_t fft_kernels_log_normalize_simd(float * state,
+											 const float * values,
+											 const size_t n,
+											 const float lo,
+											 const float inv,
+											 const float smoothing)
+{
+	size_t i;
+	float32x4_t x;
+	float32x4_t val;
+	uint32x4_t valid;
+
+	for (i = 0; i + VECTOR_SAMPLES <= n; i += VECTOR_SAMPLES) {
+		x = vld1q_f32(values + i);
+		valid = vandq_u32(vcgtq_f32(x, vdupq_n_f32(0.0f)),
+						  vcleq_f32(x, vdupq_n_f32(FLT_MAX)));
+		x = vmaxq_f32(x, vdupq_n_f32(FLT_MIN));
+		val = vmulq_n_f32(vsubq_f32(fft_kernels_log2_neon(x),
+									vdupq_n_f32(lo)), inv);
+		val = vmlaq_n_f32(vmulq_n_f32(val, 1.0f - smoothing),
+						  vld1q_f32(state + i), smoothing);
+		vst1q_f32(state + i,
+				  vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(val),
+												  valid)));
+	}
+
+	return i;
+}
+#else
+//------------------------------------------------------------------------------
+//
+// This function is used when no SIMD instruction set is available: every value
+// is computed by the scalar fallback.
+//
+//------------------------------------------------------------------------------
+static size_t fft_kernels_log_normalize_simd(float * state,
+											 const float * values,
+											 const size_t n,
+											 const float lo,
+											 const float inv,
+											 const float smoothing)
+{
+	return 0;
+}
+#endif
+
+
+//------------------------------------------------------------------------------
+//
+// This function normalizes the log2 of "n" values between the log2 of "min"
+// and "max", and smooths each result into its state by a low-pass filter.
+//
+//------------------------------------------------------------------------------
+void fft_kernels_log_normalize(float * state,
+							   const float * values,
+							   const size_t n,
+							   const float min,
+							   const float max,
+							   const float smoothing)
+{
+	size_t i;
+	size_t done;
+	float lo;
+	float hi;
+
+	assert(n == 0 || (state != NULL && values != NULL));
+
+	// Without a valid scale no value is finite
+	if (!(min > 0.0f && max > min && max <= FLT_MAX)) {
+		for (i = 0; i < n; ++i) {
+			state[i] = 0.0f;
+		}
+		return;
+	}
+
+	lo = fft_kernels_log2_scalar(MAX(min, FLT_MIN));
+	hi = fft_kernels_log2_scalar(max);
+	if (!(hi > lo)) {
+		for (i = 0; i < n; ++i) {
+			state[i] = 0.0f;
+		}
+		return;
+	}
+
+	done = fft_kernels_log_normalize_simd(state, values, n, lo,
+										  1.0f / (hi - lo), smoothing);
+	fft_kernels_log_normalize_scalar(state, values, done, n, lo,
+									 1.0f / (hi - lo), smoothing);
+}
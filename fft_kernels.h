@@ -0,0 +1,168 @@
+//------------------------------------------------------------------------------
+//
+// FFT_KERNELS
+//
+// MODULE OF THE VECTORIZED KERNELS USED ON EACH FRAME OF AUDIO ANALYSIS.
+//
+// Each kernel has a SIMD implementation (SSE on x86, NEON on ARM) and a scalar
+// fallback, selected at compile time. The magnitude kernel is also selected at
+// runtime on x86, using AVX-512 or AVX2 when the CPU supports them.
+// All kernels accept unaligned buffers and are thread safe.
+//
+//------------------------------------------------------------------------------
+#ifndef FFT_KERNELS_H
+#define FFT_KERNELS_H
+
+
+#include <stdlib.h>
+
+
+//------------------------------------------------------------------------------
+// FFT_KERNELS GLOBAL STRUCTURES DECLARATION
+//------------------------------------------------------------------------------
+typedef struct {
+	float min;		// minimum value, FLT_MAX if there are no values
+	float max;		// maximum value, FLT_MIN if there are no values
+	float sum;		// sum of the values
+} fft_kernels_reduction;
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function downmixes, scales and windows "n" interleaved audio samples in
+// a single pass. Each element is calculated as follows:
+// dst[i] = scale * window[i] * (src[i * channels] + ... +
+//                               src[i * channels + channels - 1])
+//
+// PARAMETERS
+// dst: the buffer of "n" values to be filled
+// src: the buffer of "n * channels" interleaved values
+// window: the "n" windowing values, NULL to not apply any windowing
+// n: the number of samples
+// channels: the number of channels of "src"
+// scale: the factor by which the values are scaled
+//
+//------------------------------------------------------------------------------
+void fft_kernels_downmix(float * dst,
+						 const float * src,
+						 const float * window,
+						 const size_t n,
+						 const size_t channels,
+						 const float scale);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function splits "n" interleaved audio samples into one buffer per
+// channel, scaling and windowing them in a single pass. Each element is
+// calculated as follows:
+// dst[j][i] = scale * window[i] * src[i * channels + j]
+//
+// PARAMETERS
+// dst: the "channels" buffers of "n" values to be filled
+// src: the buffer of "n * channels" interleaved values
+// window: the "n" windowing values, NULL to not apply any windowing
+// n: the number of samples
+// channels: the number of channels of "src"
+// scale: the factor by which the values are scaled
+//
+//------------------------------------------------------------------------------
+void fft_kernels_deinterleave(float * const dst[],
+							  const float * src,
+							  const float * window,
+							  const size_t n,
+							  const size_t channels,
+							  const float scale);
+
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function computes the magnitude of "n" complex values and reduces them
+// to their minimum, maximum and sum in a single pass. Each magnitude is
+// calculated as follows:
+// mag[i] = spectrum[i][0] ^ 2 + spectrum[i][1] ^ 2
+//
+// The SIMD implementations match the scalar one within these tolerances:
+// - each magnitude, and so the minimum and the maximum, within 1 ulp, since a
+//   CPU with FMA may fuse the multiply-add;
+// - the sum within a relative error of n * FLT_EPSILON, since it is summed in
+//   a different order (in practice it is closer to the exact sum, because
+//   each SIMD lane accumulates only a fraction of the values).
+//
+// PARAMETERS
+// mag: the buffer of "n" magnitudes to be filled
+// spectrum: the "n" complex values, laid out as fftwf_complex
+// n: the number of values
+// reduction: where the minimum, maximum and sum of magnitudes are stored
+//
+//------------------------------------------------------------------------------
+void fft_kernels_magnitude(float * mag,
+						   const float spectrum[][2],
+						   const size_t n,
+						   fft_kernels_reduction * reduction);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function computes the dot product of two buffers of "n" values:
+// a[0] * b[0] + ... + a[n - 1] * b[n - 1]
+// The SIMD implementations sum the products in a different order than the
+// scalar one, so the result may differ within a relative error of
+// n * FLT_EPSILON.
+//
+// PARAMETERS
+// a: the first buffer of "n" values
+// b: the second buffer of "n" values
+// n: the number of values
+//
+// RETURN
+// The dot product of the two buffers.
+//
+//------------------------------------------------------------------------------
+float fft_kernels_dot(const float * a,
+					  const float * b,
+					  const size_t n);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function normalizes the log2 of "n" values between the log2 of "min"
+// and "max", and smooths each result into its state by a low-pass filter, in
+// a single pass. Each state is updated as follows:
+// val      = (log2(values[i]) - log2(min)) / (log2(max) - log2(min))
+// state[i] = smoothing * state[i] + (1 - smoothing) * val
+// If "val" is not finite (a value or "min" not positive, a value not finite,
+// "max" equal to "min"), the state is reset to 0 instead.
+// The log2 is a fast approximation, whose absolute error is below 2e-7 plus
+// the rounding of the result to float (up to 4e-6 for the largest exponents);
+// values below FLT_MIN are treated as FLT_MIN. The SSE implementation
+// performs the same operations as the scalar one, while the NEON one divides
+// by a reciprocal estimate refined by two Newton-Raphson steps: its log2 may
+// differ from the scalar one within 2e-7 plus 1 ulp of the result (up to 8e-6
+// for the largest exponents), before the normalization scales the difference
+// by 1 / (log2(max) - log2(min)).
+//
+// PARAMETERS
+// state: the buffer of "n" smoothed values to be updated
+// values: the "n" positive values to be normalized
+// n: the number of values
+// min: the value normalized to 0
+// max: the value normalized to 1
+// smoothing: the weight of the previous state, between 0 and 1
+//
+//------------------------------------------------------------------------------
+void fft_kernels_log_normalize(float * state,
+							   const float * values,
+							   const size_t n,
+							   const float min,
+							   const float max,
+							   const float smoothing);
+
+
+#endif
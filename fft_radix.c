@@ -0,0 +1,296 @@
+#include "fft_radix.h"
+#include <math.h>
+#include <assert.h>
+
+
+//------------------------------------------------------------------------------
+// FFT_RADIX LOCAL STRUCT DEFINITIONS
+//------------------------------------------------------------------------------
+typedef struct {
+	float re;
+	float im;
+} fft_radix_cpx;
+
+struct fft_radix {
+	fft_radix_cpx * work;						// Spectrum of the pairs
+	fft_radix_cpx * tw1;						// W_n^k of each level "n"
+	fft_radix_cpx * tw3;						// W_n^3k of each level "n"
+	fft_radix_cpx * split;						// W_N^k of the split pass
+	size_t n;									// Num. of real values
+	size_t half;								// Num. of complex pairs
+};
+
+
+//------------------------------------------------------------------------------
+//
+// This function is a help function that combines the three sub-transforms of a
+// split-radix level of "n" values, stored in "out" as the transform of the
+// even values followed by the ones of the values 4m + 1 and 4m + 3:
+// X[k]          = U[k]          + (W^k Z[k] + W^3k Z'[k])
+// X[k + n / 2]  = U[k]          - (W^k Z[k] + W^3k Z'[k])
+// X[k + n / 4]  = U[k + n / 4]  - i (W^k Z[k] - W^3k Z'[k])
+// X[k + 3n / 4] = U[k + n / 4]  + i (W^k Z[k] - W^3k Z'[k])
+// It is inlined in each specialized level, where "n" is a constant.
+//
+//------------------------------------------------------------------------------
+static inline void fft_radix_butterflies(fft_radix_cpx * out,
+										 const size_t n,
+										 const fft_radix_cpx * w1,
+										 const fft_radix_cpx * w3)
+{
+	size_t k;
+	fft_radix_cpx a;
+	fft_radix_cpx b;
+	fft_radix_cpx s;
+	fft_radix_cpx d;
+	fft_radix_cpx u0;
+	fft_radix_cpx u1;
+	const size_t q = n / 4;
+
+	for (k = 0; k < q; ++k) {
+		a.re = w1[k].re * out[2 * q + k].re - w1[k].im * out[2 * q + k].im;
+		a.im = w1[k].re * out[2 * q + k].im + w1[k].im * out[2 * q + k].re;
+		b.re = w3[k].re * out[3 * q + k].re - w3[k].im * out[3 * q + k].im;
+		b.im = w3[k].re * out[3 * q + k].im + w3[k].im * out[3 * q + k].re;
+
+		s.re = a.re + b.re;
+		s.im = a.im + b.im;
+		d.re = a.re - b.re;
+		d.im = a.im - b.im;
+		u0 = out[k];
+		u1 = out[q + k];
+
+		out[k].re = u0.re + s.re;
+		out[k].im = u0.im + s.im;
+		out[2 * q + k].re = u0.re - s.re;
+		out[2 * q + k].im = u0.im - s.im;
+		out[q + k].re = u1.re + d.im;
+		out[q + k].im = u1.im - d.re;
+		out[3 * q + k].re = u1.re - d.im;
+		out[3 * q + k].im = u1.im + d.re;
+	}
+}
+
+
+//------------------------------------------------------------------------------
+//
+// These functions are the specialized levels of the split-radix recursion. Each
+// one transforms "n" complex values read from "in" every "stride" values. The
+// twiddles of the level "n" are stored from the index n / 4 of the tables.
+//
+//------------------------------------------------------------------------------
+static void fft_radix_level_1(const float (*in)[2],
+							  fft_radix_cpx * out,
+							  const size_t stride,
+							  const fft_radix_cpx * tw1,
+							  const fft_radix_cpx * tw3)
+{
+	out[0].re = in[0][0];
+	out[0].im = in[0][1];
+}
+
+static void fft_radix_level_2(const float (*in)[2],
+							  fft_radix_cpx * out,
+							  const size_t stride,
+							  const fft_radix_cpx * tw1,
+							  const fft_radix_cpx * tw3)
+{
+	out[0].re = in[0][0] + in[stride][0];
+	out[0].im = in[0][1] + in[stride][1];
+	out[1].re = in[0][0] - in[stride][0];
+	out[1].im = in[0][1] - in[stride][1];
+}
+
+#define FFT_RADIX_LEVEL(n, half, quarter)									\
+static void fft_radix_level_##n(const float (*in)[2],						\
+								fft_radix_cpx * out,						\
+								const size_t stride,						\
+								const fft_radix_cpx * tw1,					\
+								const fft_radix_cpx * tw3)					\
+{																			\
+	fft_radix_level_##half(in, out, 2 * stride, tw1, tw3);					\
+	fft_radix_level_##quarter(in + stride, out + half,						\
+							  4 * stride, tw1, tw3);						\
+	fft_radix_level_##quarter(in + 3 * stride, out + half + quarter,		\
+							  4 * stride, tw1, tw3);						\
+	fft_radix_butterflies(out, n, tw1 + quarter, tw3 + quarter);			\
+}
+
+FFT_RADIX_LEVEL(4, 2, 1)
+FFT_RADIX_LEVEL(8, 4, 2)
+FFT_RADIX_LEVEL(16, 8, 4)
+FFT_RADIX_LEVEL(32, 16, 8)
+FFT_RADIX_LEVEL(64, 32, 16)
+FFT_RADIX_LEVEL(128, 64, 32)
+FFT_RADIX_LEVEL(256, 128, 64)
+FFT_RADIX_LEVEL(512, 256, 128)
+FFT_RADIX_LEVEL(1024, 512, 256)
+
+
+//------------------------------------------------------------------------------
+//
+// This function is a help function that transforms "n" complex values with
+// the specialized level of that length, or recursing generically while "n" is
+// longer than the specialized ones.
+//
+//------------------------------------------------------------------------------
+static void fft_radix_level(const float (*in)[2],
+							fft_radix_cpx * out,
+							const size_t n,
+							const size_t stride,
+							const fft_radix_cpx * tw1,
+							const fft_radix_cpx * tw3)
+{
+	switch (n) {
+		case 1:    fft_radix_level_1(in, out, stride, tw1, tw3);    return;
+		case 2:    fft_radix_level_2(in, out, stride, tw1, tw3);    return;
+		case 4:    fft_radix_level_4(in, out, stride, tw1, tw3);    return;
+		case 8:    fft_radix_level_8(in, out, stride, tw1, tw3);    return;
+		case 16:   fft_radix_level_16(in, out, stride, tw1, tw3);   return;
+		case 32:   fft_radix_level_32(in, out, stride, tw1, tw3);   return;
+		case 64:   fft_radix_level_64(in, out, stride, tw1, tw3);   return;
+		case 128:  fft_radix_level_128(in, out, stride, tw1, tw3);  return;
+		case 256:  fft_radix_level_256(in, out, stride, tw1, tw3);  return;
+		case 512:  fft_radix_level_512(in, out, stride, tw1, tw3);  return;
+		case 1024: fft_radix_level_1024(in, out, stride, tw1, tw3); return;
+		default:   break;
+	}
+
+	fft_radix_level(in, out, n / 2, 2 * stride, tw1, tw3);
+	fft_radix_level(in + stride, out + n / 2, n / 4, 4 * stride, tw1, tw3);
+	fft_radix_level(in + 3 * stride, out + 3 * n / 4, n / 4, 4 * stride,
+					tw1, tw3);
+	fft_radix_butterflies(out, n, tw1 + n / 4, tw3 + n / 4);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function returns whether the built-in FFT supports the provided length.
+//
+//------------------------------------------------------------------------------
+int fft_radix_supports(const size_t n)
+{
+	return n >= 2 && (n & (n - 1)) == 0;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function creates a new FFT of "n" real values. The twiddles of each
+// level "n" of the recursion are stored contiguously from the index n / 4,
+// so that the levels do not overlap and each one reads them with unit stride.
+//
+//------------------------------------------------------------------------------
+int fft_radix_init(fft_radix ** fft_ptr,
+				   const size_t n)
+{
+	size_t i;
+	size_t k;
+	size_t q;
+	fft_radix * fft;
+
+	assert(fft_ptr != NULL);
+	assert(fft_radix_supports(n));
+
+	*fft_ptr = NULL;
+
+	fft = calloc(1, sizeof(fft_radix));
+	if (fft == NULL) {
+		return FFT_RADIX_ERROR;
+	}
+
+	fft->n = n;
+	fft->half = n / 2;
+	fft->work = malloc(fft->half * sizeof(fft_radix_cpx));
+	fft->tw1 = malloc((fft->half / 2 + 1) * sizeof(fft_radix_cpx));
+	fft->tw3 = malloc((fft->half / 2 + 1) * sizeof(fft_radix_cpx));
+	fft->split = malloc((fft->half + 1) * sizeof(fft_radix_cpx));
+
+	if (fft->work == NULL || fft->tw1 == NULL || fft->tw3 == NULL ||
+		fft->split == NULL) {
+		fft_radix_free(fft);
+		return FFT_RADIX_ERROR;
+	}
+
+	for (i = 4; i <= fft->half; i *= 2) {
+		q = i / 4;
+		for (k = 0; k < q; ++k) {
+			fft->tw1[q + k].re = cos(2.0 * M_PI * k / i);
+			fft->tw1[q + k].im = -sin(2.0 * M_PI * k / i);
+			fft->tw3[q + k].re = cos(2.0 * M_PI * 3 * k / i);
+			fft->tw3[q + k].im = -sin(2.0 * M_PI * 3 * k / i);
+		}
+	}
+
+	for (k = 0; k <= fft->half; ++k) {
+		fft->split[k].re = cos(2.0 * M_PI * k / n);
+		fft->split[k].im = -sin(2.0 * M_PI * k / n);
+	}
+
+	*fft_ptr = fft;
+	return FFT_RADIX_SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function computes the spectrum of "n" real values. The values are read
+// as n / 2 complex pairs z[m] = in[2m] + i * in[2m + 1], whose transform Z is
+// split into the spectra of the even and odd values:
+// E[k] = (Z[k] + conj(Z[n / 2 - k])) / 2
+// O[k] = (Z[k] - conj(Z[n / 2 - k])) / 2i
+// out[k] = E[k] + W_n^k * O[k]
+//
+//------------------------------------------------------------------------------
+void fft_radix_execute(fft_radix * fft,
+					   const float * in,
+					   float out[][2])
+{
+	size_t k;
+	fft_radix_cpx a;
+	fft_radix_cpx b;
+	float e_re;
+	float e_im;
+	float o_re;
+	float o_im;
+	const size_t M = fft->half;
+
+	assert(fft != NULL);
+	assert(in != NULL && out != NULL);
+
+	fft_radix_level((const float (*)[2])in, fft->work, M, 1,
+					fft->tw1, fft->tw3);
+
+	for (k = 0; k <= M; ++k) {
+		a = fft->work[(k == M) ? 0 : k];
+		b = fft->work[(k == 0) ? 0 : M - k];
+
+		e_re = 0.5f * (a.re + b.re);
+		e_im = 0.5f * (a.im - b.im);
+		o_re = 0.5f * (a.im + b.im);
+		o_im = 0.5f * (b.re - a.re);
+
+		out[k][0] = e_re + fft->split[k].re * o_re - fft->split[k].im * o_im;
+		out[k][1] = e_im + fft->split[k].re * o_im + fft->split[k].im * o_re;
+	}
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function frees all data and data structures used by the FFT.
+//
+//------------------------------------------------------------------------------
+void fft_radix_free(fft_radix * fft)
+{
+	if (fft == NULL) {
+		return;
+	}
+
+	free(fft->work);
+	free(fft->tw1);
+	free(fft->tw3);
+	free(fft->split);
+	free(fft);
+}
@@ -0,0 +1,109 @@
+//------------------------------------------------------------------------------
+//
+// FFT_RADIX
+//
+// MODULE OF THE BUILT-IN FAST FOURIER TRANSFORM OF REAL VALUES.
+//
+// This module provides a self-contained FFT of real values whose length is a
+// power of two, so that the audio analysis does not require an external FFT
+// library. A real FFT of N values is computed as a split-radix complex FFT of
+// the N / 2 even/odd pairs, followed by a pass that separates their spectra.
+// The recursion of the split-radix is specialized at compile time for every
+// length up to FFT_RADIX_UNROLLED_MAX real values (e.g. 512, 1024 and 2048),
+// so that every loop has a constant trip count, and the twiddle factors of
+// each level are precomputed in contiguous tables. Longer lengths recurse
+// generically down to the specialized levels.
+// Executing a transform is thread UNSAFE on the same fft_radix, since each one
+// owns its work buffer.
+//
+//------------------------------------------------------------------------------
+#ifndef FFT_RADIX_H
+#define FFT_RADIX_H
+
+
+#include <stdlib.h>
+
+
+//------------------------------------------------------------------------------
+// FFT_RADIX GLOBAL CONSTANTS
+//------------------------------------------------------------------------------
+#define FFT_RADIX_SUCCESS			0
+#define FFT_RADIX_ERROR				1
+
+// Longest real length whose recursion is fully specialized at compile time
+#define FFT_RADIX_UNROLLED_MAX		2048
+
+
+//------------------------------------------------------------------------------
+// FFT_RADIX GLOBAL STRUCTURES DECLARATION
+//------------------------------------------------------------------------------
+typedef struct fft_radix fft_radix;
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function returns whether the built-in FFT supports the provided length.
+//
+// PARAMETERS
+// n: the number of real values to be transformed
+//
+// RETURN
+// 1 if "n" is a power of two not lower than 2, 0 otherwise.
+//
+//------------------------------------------------------------------------------
+int fft_radix_supports(const size_t n);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function creates a new FFT of "n" real values, precomputing its
+// twiddle factors.
+//
+// PARAMETERS
+// fft: where the pointer to the new FFT is stored
+// n: the number of real values, supported by fft_radix_supports()
+//
+// RETURN
+// If the FFT cannot be allocated, this function returns FFT_RADIX_ERROR and
+// "fft" is set to NULL.
+// Otherwise it returns FFT_RADIX_SUCCESS.
+//
+//------------------------------------------------------------------------------
+int fft_radix_init(fft_radix ** fft,
+				   const size_t n);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function computes the n / 2 + 1 non-redundant complex values of the
+// discrete Fourier transform of "n" real values, with the same sign and
+// scaling of FFTW:
+// out[k] = sum of in[j] * e^(-2 * pi * i * j * k / n), for j in [0, n)
+//
+// PARAMETERS
+// fft: the FFT
+// in: the "n" real values
+// out: the n / 2 + 1 complex values to be filled, laid out as fftwf_complex
+//
+//------------------------------------------------------------------------------
+void fft_radix_execute(fft_radix * fft,
+					   const float * in,
+					   float out[][2]);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function frees all data and data structures used by the FFT.
+//
+// PARAMETERS
+// fft: the FFT to be freed, it may be NULL
+//
+//------------------------------------------------------------------------------
+void fft_radix_free(fft_radix * fft);
+
+
+#endif
@@ -0,0 +1,237 @@
+#include "fft_reader.h"
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+
+//------------------------------------------------------------------------------
+// FFT_READER LOCAL CONSTANTS
+//------------------------------------------------------------------------------
+#define POLL_NANOSEC			1000000		// Sleep of the reader thread while
+											// the ring is full (1 ms)
+
+#define PUSH_FULL				0			// The ring is full
+#define PUSH_DONE				1			// A frame has been decoded
+#define PUSH_EOF				2			// The source is over
+
+
+//------------------------------------------------------------------------------
+// FFT_READER LOCAL STRUCT DEFINITIONS
+//------------------------------------------------------------------------------
+struct fft_reader {
+	fft_reader_decode decode;					// Decoder of the source
+	void * source;								// Source of the values
+	float * frames;								// Ring of decoded frames
+	size_t * counts;							// Values decoded in each frame
+	size_t frame_values;						// Num. of values of a frame
+	size_t lookahead;							// Num. of frames of the ring
+	size_t head;								// Frames pushed, written by
+												// the reader thread only
+	size_t tail;								// Frames popped, written by
+												// the consumer only
+	int eof;									// Whether the source is over
+	int stop;									// Whether the thread must stop
+	int running;								// Whether the thread exists
+	pthread_t thread;							// Reader thread
+};
+
+
+//------------------------------------------------------------------------------
+//
+// This function is a help function that decodes the next frame into the ring,
+// if it is not full. The frame is published by advancing the head only after
+// it has been written, with release semantics, so that the consumer reading
+// the head with acquire semantics always sees the whole frame. The end of the
+// source is published after the last frame, in the same way.
+//
+//------------------------------------------------------------------------------
+static int fft_reader_push(fft_reader * reader)
+{
+	size_t head;
+	size_t tail;
+	size_t slot;
+	size_t count;
+
+	head = __atomic_load_n(&reader->head, __ATOMIC_RELAXED);
+	tail = __atomic_load_n(&reader->tail, __ATOMIC_ACQUIRE);
+	if (head - tail == reader->lookahead) {
+		return PUSH_FULL;
+	}
+
+	slot = head % reader->lookahead;
+	count = reader->decode(reader->source,
+						   reader->frames + slot * reader->frame_values,
+						   reader->frame_values);
+
+	if (count > 0) {
+		reader->counts[slot] = count;
+		__atomic_store_n(&reader->head, head + 1, __ATOMIC_RELEASE);
+	}
+
+	if (count < reader->frame_values) {
+		__atomic_store_n(&reader->eof, 1, __ATOMIC_RELEASE);
+		return PUSH_EOF;
+	}
+
+	return PUSH_DONE;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function is the body of the reader thread: it keeps the ring filled,
+// sleeping while it is full, until the source is over or it is stopped.
+//
+//------------------------------------------------------------------------------
+static void * fft_reader_thread(void * arg)
+{
+	int ret;
+	fft_reader * reader = arg;
+	const struct timespec poll = {0, POLL_NANOSEC};
+
+	while (!__atomic_load_n(&reader->stop, __ATOMIC_ACQUIRE)) {
+		ret = fft_reader_push(reader);
+		if (ret == PUSH_EOF) {
+			break;
+		}
+		if (ret == PUSH_FULL) {
+			nanosleep(&poll, NULL);
+		}
+	}
+
+	return NULL;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function creates a new reader, fills its ring and starts its thread.
+// The thread is explicitly scheduled by the default policy, so that it does
+// not inherit a real-time policy from the creating thread.
+//
+//------------------------------------------------------------------------------
+int fft_reader_init(fft_reader ** reader_ptr,
+					fft_reader_decode decode,
+					void * source,
+					const size_t frame_values,
+					const size_t lookahead)
+{
+	int ret;
+	fft_reader * reader;
+	pthread_attr_t attributes;
+	struct sched_param sched;
+
+	assert(reader_ptr != NULL);
+	assert(decode != NULL);
+	assert(frame_values > 0);
+	assert(lookahead > 0);
+
+	*reader_ptr = NULL;
+
+	reader = calloc(1, sizeof(fft_reader));
+	if (reader == NULL) {
+		return FFT_READER_ERROR;
+	}
+
+	reader->decode = decode;
+	reader->source = source;
+	reader->frame_values = frame_values;
+	reader->lookahead = lookahead;
+	reader->frames = malloc(lookahead * frame_values * sizeof(float));
+	reader->counts = malloc(lookahead * sizeof(size_t));
+
+	if (reader->frames == NULL || reader->counts == NULL) {
+		fft_reader_free(reader);
+		return FFT_READER_ERROR;
+	}
+
+	do {
+		ret = fft_reader_push(reader);
+	} while (ret == PUSH_DONE);
+
+	if (ret == PUSH_EOF) {
+		*reader_ptr = reader;
+		return FFT_READER_SUCCESS;
+	}
+
+	memset(&sched, 0, sizeof(sched));
+	pthread_attr_init(&attributes);
+	pthread_attr_setinheritsched(&attributes, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attributes, SCHED_OTHER);
+	pthread_attr_setschedparam(&attributes, &sched);
+	ret = pthread_create(&reader->thread, &attributes,
+						 fft_reader_thread, reader);
+	pthread_attr_destroy(&attributes);
+
+	if (ret != 0) {
+		fft_reader_free(reader);
+		return FFT_READER_ERROR;
+	}
+
+	reader->running = 1;
+	*reader_ptr = reader;
+	return FFT_READER_SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function copies the oldest decoded frame into "dst" and releases its
+// slot. The end of the source is read before the head, so that once it is
+// seen the head already includes the last frame.
+//
+//------------------------------------------------------------------------------
+int fft_reader_pop(fft_reader * reader,
+				   float * dst,
+				   size_t * count)
+{
+	int eof;
+	size_t head;
+	size_t tail;
+	size_t slot;
+
+	assert(reader != NULL);
+	assert(dst != NULL && count != NULL);
+
+	*count = 0;
+	tail = __atomic_load_n(&reader->tail, __ATOMIC_RELAXED);
+	eof = __atomic_load_n(&reader->eof, __ATOMIC_ACQUIRE);
+	head = __atomic_load_n(&reader->head, __ATOMIC_ACQUIRE);
+
+	if (head == tail) {
+		return eof ? FFT_READER_EOF : FFT_READER_UNDERRUN;
+	}
+
+	slot = tail % reader->lookahead;
+	*count = reader->counts[slot];
+	memcpy(dst, reader->frames + slot * reader->frame_values,
+		   *count * sizeof(float));
+	__atomic_store_n(&reader->tail, tail + 1, __ATOMIC_RELEASE);
+
+	return FFT_READER_SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function stops the reader thread and frees all data and data structures
+// used by the reader.
+//
+//------------------------------------------------------------------------------
+void fft_reader_free(fft_reader * reader)
+{
+	if (reader == NULL) {
+		return;
+	}
+
+	if (reader->running) {
+		__atomic_store_n(&reader->stop, 1, __ATOMIC_RELEASE);
+		pthread_join(reader->thread, NULL);
+	}
+
+	free(reader->frames);
+	free(reader->counts);
+	free(reader);
+}
@@ -0,0 +1,114 @@
+//------------------------------------------------------------------------------
+//
+// FFT_READER
+//
+// MODULE TO DECODE AUDIO FRAMES AHEAD OF THEIR USE IN A BACKGROUND THREAD.
+//
+// This module runs a reader thread that decodes the next frames of an audio
+// source ahead of time, into a ring of frames shared with a single consumer.
+// The ring is lock-free: the consumer never blocks, never waits for the reader
+// and never calls into the source, so that disk or decoding stalls (e.g. slow
+// network file systems, compressed files) are absorbed by the decoded frames
+// instead of delaying a real-time task. The reader thread is not real-time:
+// it is scheduled by the default policy and sleeps while the ring is full.
+// The ring has a single producer, the reader thread, and a single consumer:
+// fft_reader_pop() must be called by one thread at a time.
+//
+//------------------------------------------------------------------------------
+#ifndef FFT_READER_H
+#define FFT_READER_H
+
+
+#include <stdlib.h>
+
+
+//------------------------------------------------------------------------------
+// FFT_READER GLOBAL CONSTANTS
+//------------------------------------------------------------------------------
+#define FFT_READER_SUCCESS			0
+#define FFT_READER_ERROR			1
+#define FFT_READER_UNDERRUN			2
+#define FFT_READER_EOF				3
+
+
+//------------------------------------------------------------------------------
+// FFT_READER GLOBAL STRUCTURES DECLARATION
+//------------------------------------------------------------------------------
+// Function that decodes up to "n" values of the source into "dst" and returns
+// the num. of values decoded, 0 at the end of the source
+typedef size_t (*fft_reader_decode)(void * source,
+									float * dst,
+									const size_t n);
+
+typedef struct fft_reader fft_reader;
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function creates a new reader of frames of "frame_values" values each,
+// with a ring of "lookahead" frames. The ring is filled before returning, so
+// that the first frames are available right away, then the reader thread
+// keeps it filled.
+// From now on the source is used by the reader thread only, until the reader
+// is freed.
+//
+// PARAMETERS
+// reader: where the pointer to the new reader is stored
+// decode: the function that decodes the values of the source
+// source: the source passed to "decode"
+// frame_values: the num. of values of each frame
+// lookahead: the num. of frames decoded ahead, greater than 0
+//
+// RETURN
+// If the reader cannot be allocated or its thread cannot be created, this
+// function returns FFT_READER_ERROR and "reader" is set to NULL.
+// Otherwise it returns FFT_READER_SUCCESS.
+//
+//------------------------------------------------------------------------------
+int fft_reader_init(fft_reader ** reader,
+					fft_reader_decode decode,
+					void * source,
+					const size_t frame_values,
+					const size_t lookahead);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function copies the oldest decoded frame into "dst" and releases its
+// slot of the ring to the reader thread. It never blocks.
+//
+// PARAMETERS
+// reader: the reader
+// dst: a float buffer of "frame_values" values
+// count: where the num. of values decoded in the frame is stored, lower than
+//        "frame_values" for the last frame of the source
+//
+// RETURN
+// If the ring is empty because the reader thread is late, this function
+// returns FFT_READER_UNDERRUN, while if it is empty because the source is
+// over, it returns FFT_READER_EOF. In both cases "dst" is not modified and
+// "count" is set to 0.
+// Otherwise it returns FFT_READER_SUCCESS.
+//
+//------------------------------------------------------------------------------
+int fft_reader_pop(fft_reader * reader,
+				   float * dst,
+				   size_t * count);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function stops the reader thread, waiting for its end, and frees all
+// data and data structures used by the reader. The source is not closed.
+//
+// PARAMETERS
+// reader: the reader to be freed, it may be NULL
+//
+//------------------------------------------------------------------------------
+void fft_reader_free(fft_reader * reader);
+
+
+#endif
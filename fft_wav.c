@@ -0,0 +1,355 @@
+#include "fft_wav.h"
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+//------------------------------------------------------------------------------
+// FFT_WAV LOCAL CONSTANTS
+//------------------------------------------------------------------------------
+#define RIFF_HEADER_SIZE		12		// "RIFF", size, "WAVE"
+#define CHUNK_HEADER_SIZE		8		// id, size
+#define FMT_MIN_SIZE			16		// Size of the PCM fmt chunk
+#define FMT_EXTENSIBLE_SIZE		40		// Size of the extensible fmt chunk
+
+#define FORMAT_PCM				0x0001
+#define FORMAT_FLOAT			0x0003
+#define FORMAT_EXTENSIBLE		0xFFFE
+
+
+//------------------------------------------------------------------------------
+// FFT_WAV LOCAL ENUMS DEFINITIONS
+//------------------------------------------------------------------------------
+typedef enum {
+	fft_wav_u8 = 0,
+	fft_wav_s16,
+	fft_wav_s24,
+	fft_wav_s32,
+	fft_wav_f32,
+	fft_wav_f64
+} fft_wav_encoding;
+
+
+//------------------------------------------------------------------------------
+// FFT_WAV LOCAL STRUCT DEFINITIONS
+//------------------------------------------------------------------------------
+struct fft_wav {
+	const unsigned char * map;					// Mapping of the whole file
+	size_t map_size;							// Bytes of the mapping
+	const unsigned char * data;					// First sample of the file
+	fft_wav_encoding encoding;					// Encoding of the samples
+	size_t sample_bytes;						// Bytes of a sample
+	size_t samplerate;							// Samplerate of the file
+	size_t channels;							// Num. of channels
+	size_t values;								// Num. of values of the file
+	size_t pos;									// Next value to be read
+};
+
+
+//------------------------------------------------------------------------------
+//
+// These functions are help functions that read little-endian integers from
+// the mapping, which may not be aligned.
+//
+//------------------------------------------------------------------------------
+static inline uint16_t fft_wav_u16(const unsigned char * p)
+{
+	return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static inline uint32_t fft_wav_u32(const unsigned char * p)
+{
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 |
+		   (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function is a help function that parses the fmt chunk of "size" bytes
+// and sets the encoding, the samplerate and the num. of channels of the file.
+// With WAVE_FORMAT_EXTENSIBLE, the format is the first 2 bytes of the
+// sub-format GUID.
+//
+//------------------------------------------------------------------------------
+static int fft_wav_parse_fmt(fft_wav * wav,
+							 const unsigned char * fmt,
+							 const size_t size)
+{
+	unsigned format;
+	unsigned bits;
+
+	if (size < FMT_MIN_SIZE) {
+		return FFT_WAV_UNSUPPORTED;
+	}
+
+	format = fft_wav_u16(fmt);
+	wav->channels = fft_wav_u16(fmt + 2);
+	wav->samplerate = fft_wav_u32(fmt + 4);
+	bits = fft_wav_u16(fmt + 14);
+
+	if (format == FORMAT_EXTENSIBLE) {
+		if (size < FMT_EXTENSIBLE_SIZE) {
+			return FFT_WAV_UNSUPPORTED;
+		}
+		format = fft_wav_u16(fmt + 24);
+	}
+
+	if (format == FORMAT_PCM && bits == 8) {
+		wav->encoding = fft_wav_u8;
+	} else if (format == FORMAT_PCM && bits == 16) {
+		wav->encoding = fft_wav_s16;
+	} else if (format == FORMAT_PCM && bits == 24) {
+		wav->encoding = fft_wav_s24;
+	} else if (format == FORMAT_PCM && bits == 32) {
+		wav->encoding = fft_wav_s32;
+	} else if (format == FORMAT_FLOAT && bits == 32) {
+		wav->encoding = fft_wav_f32;
+	} else if (format == FORMAT_FLOAT && bits == 64) {
+		wav->encoding = fft_wav_f64;
+	} else {
+		return FFT_WAV_UNSUPPORTED;
+	}
+
+	wav->sample_bytes = bits / 8;
+	if (wav->channels == 0 || wav->samplerate == 0) {
+		return FFT_WAV_UNSUPPORTED;
+	}
+
+	return FFT_WAV_SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function is a help function that parses the RIFF header of the mapping:
+// the chunks are walked until the data chunk, which must follow the fmt one.
+// Chunks are padded to an even size. A data chunk whose size is unknown or
+// larger than the file (e.g. a truncated recording) ends with the file.
+//
+//------------------------------------------------------------------------------
+static int fft_wav_parse(fft_wav * wav)
+{
+	size_t pos;
+	size_t size;
+	int has_fmt = 0;
+	const unsigned char * map = wav->map;
+
+	if (wav->map_size < RIFF_HEADER_SIZE ||
+		memcmp(map, "RIFF", 4) != 0 || memcmp(map + 8, "WAVE", 4) != 0) {
+		return FFT_WAV_UNSUPPORTED;
+	}
+
+	pos = RIFF_HEADER_SIZE;
+	while (pos + CHUNK_HEADER_SIZE <= wav->map_size) {
+		size = fft_wav_u32(map + pos + 4);
+		pos += CHUNK_HEADER_SIZE;
+
+		if (memcmp(map + pos - CHUNK_HEADER_SIZE, "fmt ", 4) == 0) {
+			if (size > wav->map_size - pos ||
+				fft_wav_parse_fmt(wav, map + pos, size) != FFT_WAV_SUCCESS) {
+				return FFT_WAV_UNSUPPORTED;
+			}
+			has_fmt = 1;
+		} else if (memcmp(map + pos - CHUNK_HEADER_SIZE, "data", 4) == 0) {
+			if (!has_fmt) {
+				return FFT_WAV_UNSUPPORTED;
+			}
+			if (size > wav->map_size - pos) {
+				size = wav->map_size - pos;
+			}
+			wav->data = map + pos;
+			wav->values = size / wav->sample_bytes /
+						  wav->channels * wav->channels;
+			return FFT_WAV_SUCCESS;
+		}
+
+		if (size > wav->map_size - pos) {
+			break;
+		}
+		pos += size + (size & 1);
+	}
+
+	return FFT_WAV_UNSUPPORTED;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function opens and memory-maps the provided file, and parses its RIFF
+// header. The descriptor is not needed once the file is mapped.
+//
+//------------------------------------------------------------------------------
+int fft_wav_open(fft_wav ** wav_ptr,
+				 const char * filename)
+{
+	int fd;
+	int ret;
+	void * map;
+	struct stat st;
+	fft_wav * wav;
+
+	assert(wav_ptr != NULL);
+	assert(filename != NULL);
+
+	*wav_ptr = NULL;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		return FFT_WAV_ERROR_FILE;
+	}
+
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		return FFT_WAV_ERROR_FILE;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return FFT_WAV_ERROR_FILE;
+	}
+
+#if defined(MADV_SEQUENTIAL)
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+#endif
+
+	wav = calloc(1, sizeof(fft_wav));
+	if (wav == NULL) {
+		munmap(map, st.st_size);
+		return FFT_WAV_ERROR_FILE;
+	}
+
+	wav->map = map;
+	wav->map_size = st.st_size;
+	wav->pos = 0;
+
+	ret = fft_wav_parse(wav);
+	if (ret != FFT_WAV_SUCCESS) {
+		fft_wav_close(wav);
+		return ret;
+	}
+
+	*wav_ptr = wav;
+	return FFT_WAV_SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// These functions return the samplerate, the num. of channels and the num. of
+// frames of the file.
+//
+//------------------------------------------------------------------------------
+size_t fft_wav_get_samplerate(const fft_wav * wav)
+{
+	assert(wav != NULL);
+
+	return wav->samplerate;
+}
+
+size_t fft_wav_get_channels(const fft_wav * wav)
+{
+	assert(wav != NULL);
+
+	return wav->channels;
+}
+
+size_t fft_wav_get_frames(const fft_wav * wav)
+{
+	assert(wav != NULL);
+
+	return wav->values / wav->channels;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function converts up to "n" values of the file into "dst". Each
+// encoding has its own loop, so that the conversion does not branch per value.
+// Integer values are divided by 2^(bits - 1), as libsndfile does, while float
+// values are copied as they are, assuming a little-endian host.
+//
+//------------------------------------------------------------------------------
+size_t fft_wav_read(fft_wav * wav,
+					float * dst,
+					const size_t n)
+{
+	size_t i;
+	size_t count;
+	int32_t v;
+	float f;
+	double d;
+	const unsigned char * src;
+
+	assert(wav != NULL);
+	assert(n == 0 || dst != NULL);
+
+	count = wav->values - wav->pos;
+	if (count > n) {
+		count = n;
+	}
+	src = wav->data + wav->pos * wav->sample_bytes;
+
+	switch (wav->encoding) {
+		case fft_wav_u8:
+			for (i = 0; i < count; ++i) {
+				dst[i] = (src[i] - 128) * (1.0f / 0x80);
+			}
+			break;
+		case fft_wav_s16:
+			for (i = 0; i < count; ++i) {
+				dst[i] = (int16_t)fft_wav_u16(src + 2 * i) * (1.0f / 0x8000);
+			}
+			break;
+		case fft_wav_s24:
+			for (i = 0; i < count; ++i) {
+				v = (int32_t)((uint32_t)src[3 * i] << 8 |
+							  (uint32_t)src[3 * i + 1] << 16 |
+							  (uint32_t)src[3 * i + 2] << 24);
+				dst[i] = (v >> 8) * (1.0f / 0x800000);
+			}
+			break;
+		case fft_wav_s32:
+			for (i = 0; i < count; ++i) {
+				dst[i] = (int32_t)fft_wav_u32(src + 4 * i) *
+						 (1.0f / 0x80000000u);
+			}
+			break;
+		case fft_wav_f32:
+			for (i = 0; i < count; ++i) {
+				memcpy(&f, src + 4 * i, sizeof(f));
+				dst[i] = f;
+			}
+			break;
+		case fft_wav_f64:
+			for (i = 0; i < count; ++i) {
+				memcpy(&d, src + 8 * i, sizeof(d));
+				dst[i] = d;
+			}
+			break;
+	}
+
+	wav->pos += count;
+	return count;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// This function unmaps and closes the file.
+//
+//------------------------------------------------------------------------------
+void fft_wav_close(fft_wav * wav)
+{
+	if (wav == NULL) {
+		return;
+	}
+
+	munmap((void *)wav->map, wav->map_size);
+	free(wav);
+}
@@ -0,0 +1,109 @@
+//------------------------------------------------------------------------------
+//
+// FFT_WAV
+//
+// MODULE TO READ PCM WAV FILES STRAIGHT FROM THEIR MEMORY MAPPING.
+//
+// This module reads uncompressed WAV (RIFF) files without libsndfile: the
+// file is memory-mapped, its RIFF header is parsed once, and the samples are
+// converted to float values straight from the mapping, with no intermediate
+// buffering or copies. The kernel is advised that the mapping is read
+// sequentially, so that it reads ahead.
+// Supported encodings are 8, 16, 24 and 32 bits integer PCM and 32 and 64 bits
+// IEEE float, also in WAVE_FORMAT_EXTENSIBLE files. Other files (compressed
+// WAV, other containers) are reported as unsupported, to be read otherwise.
+// Values are normalized to [-1.0, 1.0] as libsndfile does by default.
+// All functions are thread UNSAFE: each file must be read by one thread at a
+// time.
+//
+//------------------------------------------------------------------------------
+#ifndef FFT_WAV_H
+#define FFT_WAV_H
+
+
+#include <stdlib.h>
+
+
+//------------------------------------------------------------------------------
+// FFT_WAV GLOBAL CONSTANTS
+//------------------------------------------------------------------------------
+#define FFT_WAV_SUCCESS				0
+#define FFT_WAV_ERROR_FILE			1
+#define FFT_WAV_UNSUPPORTED			2
+
+
+//------------------------------------------------------------------------------
+// FFT_WAV GLOBAL STRUCTURES DECLARATION
+//------------------------------------------------------------------------------
+typedef struct fft_wav fft_wav;
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function opens and memory-maps the provided file, and parses its RIFF
+// header. The read position is set to the first frame.
+//
+// PARAMETERS
+// wav: where the pointer to the new file is stored
+// filename: the path of the audio file
+//
+// RETURN
+// It returns:
+// - FFT_WAV_ERROR_FILE if the file cannot be opened or mapped
+// - FFT_WAV_UNSUPPORTED if the file is not a WAV file with a supported
+//   encoding, or its header is malformed
+// - FFT_WAV_SUCCESS otherwise
+// In case of error "wav" is set to NULL.
+//
+//------------------------------------------------------------------------------
+int fft_wav_open(fft_wav ** wav,
+				 const char * filename);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// These functions return the samplerate, the num. of channels and the num. of
+// frames (values of each channel) of the file.
+//
+//------------------------------------------------------------------------------
+size_t fft_wav_get_samplerate(const fft_wav * wav);
+size_t fft_wav_get_channels(const fft_wav * wav);
+size_t fft_wav_get_frames(const fft_wav * wav);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function converts up to "n" interleaved values of the file, starting
+// from the read position, into "dst", and advances the read position.
+//
+// PARAMETERS
+// wav: the file
+// dst: a float buffer of "n" values
+// n: the num. of values to be read
+//
+// RETURN
+// The num. of values read, lower than "n" at the end of the file.
+//
+//------------------------------------------------------------------------------
+size_t fft_wav_read(fft_wav * wav,
+					float * dst,
+					const size_t n);
+
+
+//------------------------------------------------------------------------------
+//
+// DESCRIPTION
+// This function unmaps and closes the file, and frees all data structures used
+// by it.
+//
+// PARAMETERS
+// wav: the file to be closed, it may be NULL
+//
+//------------------------------------------------------------------------------
+void fft_wav_close(fft_wav * wav);
+
+
+#endif